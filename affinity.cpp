@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "affinity.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace ClSnake {
+
+#ifdef _WIN32
+
+	// Logical processors as (group, number), the first one of each physical core before the others
+	std::vector<std::pair<WORD, BYTE>> processorOrder() {
+		std::vector<std::pair<WORD, BYTE>> primary;
+		std::vector<std::pair<WORD, BYTE>> secondary;
+
+		DWORD length = 0;
+		GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &length);
+		std::vector<char> buffer(length);
+		auto info = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data());
+
+		if (!GetLogicalProcessorInformationEx(RelationProcessorCore, info, &length)) {
+			return primary;
+		}
+
+		for (DWORD offset = 0; offset < length; offset += info->Size) {
+			info = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+			auto& mask = info->Processor.GroupMask[0];
+			bool first = true;
+			for (BYTE bit = 0; bit < sizeof(KAFFINITY) * 8; bit++) {
+				if (mask.Mask & (static_cast<KAFFINITY>(1) << bit)) {
+					(first ? primary : secondary).push_back({ mask.Group, bit });
+					first = false;
+				}
+			}
+		}
+
+		primary.insert(primary.end(), secondary.begin(), secondary.end());
+
+		return primary;
+	}
+
+	bool pinCurrentThread(ThreadAffinity affinity, int idxWorker) {
+		GROUP_AFFINITY groupAffinity = {};
+
+		if (affinity == ThreadAffinity::Core) {
+			static const auto order = processorOrder();
+			if (order.empty()) {
+				return false;
+			}
+			auto& processor = order[idxWorker % order.size()];
+			groupAffinity.Group = processor.first;
+			groupAffinity.Mask = static_cast<KAFFINITY>(1) << processor.second;
+		}
+		else if (affinity == ThreadAffinity::NumaNode) {
+			ULONG highestNode = 0;
+			if (!GetNumaHighestNodeNumber(&highestNode)) {
+				return false;
+			}
+			USHORT node = static_cast<USHORT>(idxWorker % (highestNode + 1));
+			if (!GetNumaNodeProcessorMaskEx(node, &groupAffinity) || groupAffinity.Mask == 0) {
+				return false;
+			}
+		}
+		else {
+			return true;
+		}
+
+		return SetThreadGroupAffinity(GetCurrentThread(), &groupAffinity, nullptr) != 0;
+	}
+
+#else
+
+	// Parses lists like "0-3,8,10-11"
+	std::vector<int> parseCpuList(const std::string& list) {
+		std::vector<int> cpus;
+		std::stringstream ss(list);
+		std::string range;
+
+		while (std::getline(ss, range, ',')) {
+			auto dash = range.find('-');
+			int first = std::stoi(range.substr(0, dash));
+			int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+			for (int cpu = first; cpu <= last; cpu++) {
+				cpus.push_back(cpu);
+			}
+		}
+
+		return cpus;
+	}
+
+	std::vector<int> readCpuList(const std::string& path) {
+		std::ifstream in(path);
+		std::string list;
+
+		if (!std::getline(in, list) || list.empty()) {
+			return {};
+		}
+
+		return parseCpuList(list);
+	}
+
+	// Logical processors, the first one of each physical core before the others
+	std::vector<int> processorOrder() {
+		std::vector<int> primary;
+		std::vector<int> secondary;
+
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			auto siblings = readCpuList("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list");
+			if (siblings.empty()) {
+				break;
+			}
+			(siblings.front() == cpu ? primary : secondary).push_back(cpu);
+		}
+
+		primary.insert(primary.end(), secondary.begin(), secondary.end());
+
+		return primary;
+	}
+
+	bool pinCurrentThread(ThreadAffinity affinity, int idxWorker) {
+		std::vector<int> cpus;
+
+		if (affinity == ThreadAffinity::Core) {
+			static const auto order = processorOrder();
+			if (order.empty()) {
+				return false;
+			}
+			cpus.push_back(order[idxWorker % order.size()]);
+		}
+		else if (affinity == ThreadAffinity::NumaNode) {
+			int numNodes = 0;
+			while (std::ifstream("/sys/devices/system/node/node" + std::to_string(numNodes) + "/cpulist")) {
+				numNodes++;
+			}
+			if (numNodes == 0) {
+				return false;
+			}
+			cpus = readCpuList("/sys/devices/system/node/node" + std::to_string(idxWorker % numNodes) + "/cpulist");
+		}
+		else {
+			return true;
+		}
+
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (auto cpu : cpus) {
+			CPU_SET(cpu, &set);
+		}
+
+		return !cpus.empty() && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+	}
+
+#endif
+}
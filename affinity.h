@@ -0,0 +1,9 @@
+#pragma once
+
+#include "config.h"
+
+namespace ClSnake {
+
+	// Pins the calling thread according to affinity, as worker number idxWorker. Returns false if it couldn't be done
+	bool pinCurrentThread(ThreadAffinity affinity, int idxWorker);
+}
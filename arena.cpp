@@ -0,0 +1,16 @@
+#include "arena.h"
+
+namespace ClSnake {
+
+	// make_unique zero fills the buffer, so all pages are touched by the thread that creates the arena and end up on its NUMA node
+	Arena::Arena(size_t tNumBytes) : buffer(std::make_unique<std::byte[]>(tNumBytes)), monotonic(buffer.get(), tNumBytes) {
+	}
+
+	std::pmr::memory_resource* Arena::resource() {
+		return &monotonic;
+	}
+
+	void Arena::reset() {
+		monotonic.release();
+	}
+}
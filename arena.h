@@ -0,0 +1,20 @@
+#pragma once
+
+#include <memory>
+#include <memory_resource>
+
+namespace ClSnake {
+
+	// Bump allocator that everything belonging to one game allocates from. Nothing is freed one by one;
+	//	instead the whole arena is reset when the game is done. If the buffer runs out, it falls back to the heap
+	class Arena {
+	public:
+		Arena(size_t tNumBytes);
+		std::pmr::memory_resource* resource();
+		// Only call once nothing allocated from the arena is used anymore
+		void reset();
+	private:
+		std::unique_ptr<std::byte[]> buffer;
+		std::pmr::monotonic_buffer_resource monotonic;
+	};
+}
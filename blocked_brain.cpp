@@ -0,0 +1,195 @@
+#include <algorithm>
+
+#include "blocked_brain.h"
+#include "worker_pool.h"
+
+BlockedBrain::BlockedBrain(SnakeBrain& brain) {
+	std::vector<int> layerSizes = { brain.numInputs };
+	for (int i = 0; i < brain.numHiddenLayers; i++) {
+		layerSizes.push_back(brain.hiddenLayerSize);
+	}
+	layerSizes.push_back(brain.outputLayerSize);
+
+	int perceptronOffset = 0;
+	int numColumns = brain.numInputs;
+	for (int idxLayer = 1; idxLayer < layerSizes.size(); idxLayer++) {
+		Layer layer;
+		layer.numRows = layerSizes[idxLayer];
+		layer.numPaddedRows = (layer.numRows + panelRows - 1) / panelRows * panelRows;
+		layer.numColumns = numColumns;
+		layer.weights.assign(static_cast<size_t>(layer.numPaddedRows) * numColumns, 0.0f);
+		layer.biases.assign(layer.numPaddedRows, 0.0f);
+
+		for (int row = 0; row < layer.numRows; row++) {
+			auto& perceptron = *brain.perceptrons[perceptronOffset + row];
+			const int panel = row / panelRows;
+			const int lane = row % panelRows;
+			for (int column = 0; column < layerSizes[idxLayer - 1]; column++) {
+				layer.weights[(static_cast<size_t>(panel) * numColumns + column) * panelRows + lane] = perceptron.w[column];
+			}
+			layer.biases[row] = perceptron.b;
+		}
+
+		perceptronOffset += layer.numRows;
+		numColumns = layer.numPaddedRows;
+		layers.push_back(std::move(layer));
+	}
+}
+
+void BlockedBrain::multiplyPanels(const Layer& layer, const float* in, float* out, int firstPanel, int lastPanel) {
+	for (int panel = firstPanel; panel < lastPanel; panel++) {
+		const float* w = layer.weights.data() + static_cast<size_t>(panel) * layer.numColumns * panelRows;
+		// Four independent sums per row, each taking every fourth column, so an add doesn't wait for the one before.
+		//	Separate arrays rather than one 2D array, or the compiler keeps them in memory instead of registers
+		float acc0[panelRows] = {};
+		float acc1[panelRows] = {};
+		float acc2[panelRows] = {};
+		float acc3[panelRows] = {};
+
+		int column = 0;
+		for (; column + 4 <= layer.numColumns; column += 4) {
+			const float* wc = w + column * panelRows;
+			for (int lane = 0; lane < panelRows; lane++) {
+				acc0[lane] += wc[lane] * in[column];
+				acc1[lane] += wc[panelRows + lane] * in[column + 1];
+				acc2[lane] += wc[2 * panelRows + lane] * in[column + 2];
+				acc3[lane] += wc[3 * panelRows + lane] * in[column + 3];
+			}
+		}
+		for (; column < layer.numColumns; column++) {
+			for (int lane = 0; lane < panelRows; lane++) {
+				acc0[lane] += w[column * panelRows + lane] * in[column];
+			}
+		}
+
+		for (int lane = 0; lane < panelRows; lane++) {
+			const float sum = (acc0[lane] + acc1[lane]) + (acc2[lane] + acc3[lane]);
+			out[panel * panelRows + lane] = relu(sum + layer.biases[panel * panelRows + lane]);
+		}
+	}
+}
+
+void BlockedBrain::multiplyPanelsBatch(const Layer& layer, const float* in, float* out, int batchSize) {
+	const int numPanels = layer.numPaddedRows / panelRows;
+
+	std::fill(out, out + static_cast<size_t>(batchSize) * layer.numPaddedRows, 0.0f);
+
+	// Go through the weights one cache block of columns at a time, so the slice of a panel is loaded from memory
+	//	once and then reused from L1 by every input in the batch
+	for (int firstColumn = 0; firstColumn < layer.numColumns; firstColumn += blockColumns) {
+		const int lastColumn = std::min(firstColumn + blockColumns, layer.numColumns);
+		for (int panel = 0; panel < numPanels; panel++) {
+			const float* w = layer.weights.data() + static_cast<size_t>(panel) * layer.numColumns * panelRows;
+			for (int firstInput = 0; firstInput < batchSize; firstInput += batchTile) {
+				const int numInputs = std::min(batchTile, batchSize - firstInput);
+				// A partial tile repeats its last input, and throws away the extra results
+				auto input = [&](int b) { return in + static_cast<size_t>(firstInput + std::min(b, numInputs - 1)) * layer.numColumns; };
+				const float* x0 = input(0);
+				const float* x1 = input(1);
+				const float* x2 = input(2);
+				const float* x3 = input(3);
+				// batchTile x panelRows outputs kept in registers, one array per input as in multiplyPanels()
+				float acc0[panelRows] = {};
+				float acc1[panelRows] = {};
+				float acc2[panelRows] = {};
+				float acc3[panelRows] = {};
+
+				for (int column = firstColumn; column < lastColumn; column++) {
+					const float* wc = w + column * panelRows;
+					for (int lane = 0; lane < panelRows; lane++) {
+						acc0[lane] += wc[lane] * x0[column];
+						acc1[lane] += wc[lane] * x1[column];
+						acc2[lane] += wc[lane] * x2[column];
+						acc3[lane] += wc[lane] * x3[column];
+					}
+				}
+
+				const float* acc[batchTile] = { acc0, acc1, acc2, acc3 };
+				for (int b = 0; b < numInputs; b++) {
+					float* o = out + static_cast<size_t>(firstInput + b) * layer.numPaddedRows + panel * panelRows;
+					for (int lane = 0; lane < panelRows; lane++) {
+						o[lane] += acc[b][lane];
+					}
+				}
+			}
+		}
+	}
+
+	for (int b = 0; b < batchSize; b++) {
+		float* o = out + static_cast<size_t>(b) * layer.numPaddedRows;
+		for (int row = 0; row < layer.numPaddedRows; row++) {
+			o[row] = relu(o[row] + layer.biases[row]);
+		}
+	}
+}
+
+std::span<const float> BlockedBrain::think(std::span<const float> inputs, ThinkBuffers& buffers) const {
+	return forward(inputs, buffers, nullptr);
+}
+
+std::span<const float> BlockedBrain::think(std::span<const float> inputs, ThinkBuffers& buffers, ClSnake::WorkerPool& pool) const {
+	return forward(inputs, buffers, ClSnake::WorkerPool::currentWorker() < 0 ? &pool : nullptr);
+}
+
+std::span<const float> BlockedBrain::forward(std::span<const float> inputs, ThinkBuffers& buffers, ClSnake::WorkerPool* pool) const {
+	auto& activations = buffers.current;
+	auto& newActivations = buffers.next;
+
+	activations.assign(inputs.begin(), inputs.end());
+	if (buffers.keepHidden) {
+		buffers.hidden.clear();
+	}
+
+	for (int idxLayer = 0; idxLayer < layers.size(); idxLayer++) {
+		auto& layer = layers[idxLayer];
+		const int numPanels = layer.numPaddedRows / panelRows;
+		newActivations.resize(layer.numPaddedRows);
+
+		const int panelsPerTask = std::max(1, minWeightsPerTask / (layer.numColumns * panelRows));
+		const int numTasks = (numPanels + panelsPerTask - 1) / panelsPerTask;
+		if (pool != nullptr && pool->size() > 1 && numTasks > 1) {
+			pool->parallelFor(numTasks, [&layer, &activations, &newActivations, panelsPerTask, numPanels](int idxTask) {
+				const int firstPanel = idxTask * panelsPerTask;
+				multiplyPanels(layer, activations.data(), newActivations.data(), firstPanel, std::min(firstPanel + panelsPerTask, numPanels));
+				});
+		}
+		else {
+			multiplyPanels(layer, activations.data(), newActivations.data(), 0, numPanels);
+		}
+
+		if (buffers.keepHidden && idxLayer < layers.size() - 1) {
+			buffers.hidden.insert(buffers.hidden.end(), newActivations.begin(), newActivations.begin() + layer.numRows);
+		}
+		activations.swap(newActivations);
+	}
+
+	return std::span<const float>(activations.data(), layers.back().numRows);
+}
+
+void BlockedBrain::thinkBatch(std::span<const float> inputs, int batchSize, ThinkBuffers& buffers, std::vector<float>& outputs) const {
+	auto& activations = buffers.current;
+	auto& newActivations = buffers.next;
+
+	activations.assign(inputs.begin(), inputs.begin() + static_cast<size_t>(batchSize) * numInputs());
+
+	for (auto& layer : layers) {
+		newActivations.resize(static_cast<size_t>(batchSize) * layer.numPaddedRows);
+		multiplyPanelsBatch(layer, activations.data(), newActivations.data(), batchSize);
+		activations.swap(newActivations);
+	}
+
+	// Drop the padding rows of the output layer
+	const int numPaddedOutputs = layers.back().numPaddedRows;
+	outputs.resize(static_cast<size_t>(batchSize) * numOutputs());
+	for (int b = 0; b < batchSize; b++) {
+		std::copy_n(activations.begin() + static_cast<size_t>(b) * numPaddedOutputs, numOutputs(), outputs.begin() + static_cast<size_t>(b) * numOutputs());
+	}
+}
+
+int BlockedBrain::numInputs() const {
+	return layers.front().numColumns;
+}
+
+int BlockedBrain::numOutputs() const {
+	return layers.back().numRows;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <span>
+
+#include "snake.h"
+
+namespace ClSnake {
+	class WorkerPool;
+}
+
+// Compiled form of a SnakeBrain for wide layers. The per perceptron vectors of SnakeBrain are scattered over the
+//	heap, which is fine for 20 neurons but not for hundreds. Here each layer is one contiguous block, stored as
+//	panels of panelRows rows, column by column: the panelRows weights that meet one input are next to each other,
+//	so a panel is multiplied with the input by broadcasting one input at a time, panelRows outputs at once.
+//
+// Sums are done in a different order than SnakeBrain::think, so the outputs can differ in the last bits.
+class BlockedBrain {
+public:
+	// Outputs computed together; the layers are padded with zero rows to a multiple of this
+	static constexpr int panelRows = 8;
+	// Inputs computed together by thinkBatch(), reusing each loaded weight this many times. The kernel is written out
+	//	for exactly four
+	static constexpr int batchTile = 4;
+	// Columns per cache block in thinkBatch(). A panel slice (8 KB) and batchTile inputs (4 KB) stay in L1
+	static constexpr int blockColumns = 256;
+	// Least number of weights per task when a layer is split over a pool
+	static constexpr int minWeightsPerTask = 1 << 15;
+
+	BlockedBrain(SnakeBrain& brain);
+
+	// Same as SnakeBrain::think
+	std::span<const float> think(std::span<const float> inputs, ThinkBuffers& buffers) const;
+	// Same, with each layer split over pool, for one large brain. When called from a worker of the pool it runs on
+	//	the calling thread only, since the other workers may be busy with games. Only the think benchmark uses it so
+	//	far: games think one step at a time on the worker that plays them
+	std::span<const float> think(std::span<const float> inputs, ThinkBuffers& buffers, ClSnake::WorkerPool& pool) const;
+	// Thinks about batchSize inputs of numInputs() floats, stored one after the other. Stores batchSize times
+	//	numOutputs() floats in outputs, using buffers as scratch space. Much faster per input than think(), since each
+	//	weight is loaded once per batch tile. Only the think benchmark uses it so far, since a game has one input per step
+	void thinkBatch(std::span<const float> inputs, int batchSize, ThinkBuffers& buffers, std::vector<float>& outputs) const;
+	int numInputs() const;
+	int numOutputs() const;
+private:
+	struct Layer {
+		int numRows;
+		// Rounded up to panelRows
+		int numPaddedRows;
+		// numPaddedRows of the layer before, or the number of inputs for the first layer
+		int numColumns;
+		// Element l of column c of panel p is at weights[(p * numColumns + c) * panelRows + l]
+		std::vector<float> weights;
+		std::vector<float> biases;
+	};
+
+	std::vector<Layer> layers;
+
+	// Computes the outputs of panels firstPanel to lastPanel - 1 for one input
+	static void multiplyPanels(const Layer& layer, const float* in, float* out, int firstPanel, int lastPanel);
+	// Same for batchSize inputs, numColumns floats each. out holds numPaddedRows floats per input
+	static void multiplyPanelsBatch(const Layer& layer, const float* in, float* out, int batchSize);
+	std::span<const float> forward(std::span<const float> inputs, ThinkBuffers& buffers, ClSnake::WorkerPool* pool) const;
+};
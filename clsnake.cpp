@@ -11,6 +11,9 @@
 #include "game.h"
 #include "evolution.h"
 #include "config.h"
+#include "sweep.h"
+#include "pruning.h"
+#include "think_benchmark.h"
 
 
 // Needed for SDL2
@@ -31,8 +34,68 @@ TTF_Font* loadFont(const char* fontPath, int fontSize) {
 	return font;
 }
 
-int main() 
+// Arguments are --config=file, --sweep=file, --benchmark=think and --key=value, eg. --evolution.mutationProbability=0.02.
+//	They are applied in order, so a later argument overrides an earlier one
+bool parseArguments(int argc, char** argv, SnakeConfiguration& config, std::string& sweepPath, std::string& benchmark) {
+	bool ok = true;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		auto eq = arg.find('=');
+		if (arg.rfind("--", 0) != 0 || eq == std::string::npos) {
+			std::cout << "Expected --key=value, got " << arg << std::endl;
+			ok = false;
+			continue;
+		}
+
+		auto key = arg.substr(2, eq - 2);
+		auto value = arg.substr(eq + 1);
+		if (key == "config") {
+			ok = config.loadFile(value) && ok;
+		}
+		else if (key == "sweep") {
+			sweepPath = value;
+		}
+		else if (key == "benchmark") {
+			if (value != "think") {
+				std::cout << "Unknown benchmark " << value << std::endl;
+				ok = false;
+			}
+			benchmark = value;
+		}
+		else {
+			ok = config.set(key, value) && ok;
+		}
+	}
+
+	return ok;
+}
+
+int main(int argc, char** argv) 
 {
+	SnakeConfiguration config;
+	std::string sweepPath;
+	std::string benchmark;
+
+	if (!parseArguments(argc, argv, config, sweepPath, benchmark) || !config.validate()) {
+		return 1;
+	}
+
+	if (benchmark == "think") {
+		ClSnake::runThinkBenchmark(config);
+		return 0;
+	}
+
+	// A sweep only prints its results, there is nothing to replay
+	if (!sweepPath.empty()) {
+		std::vector<ClSnake::SweepRun> runs;
+		if (!ClSnake::loadSweep(sweepPath, config, runs)) {
+			return 1;
+		}
+		ClSnake::printSweepResults(ClSnake::runSweep(runs, config));
+		return 0;
+	}
+
 	if (SDL_Init(SDL_INIT_EVERYTHING) != 0) { 
 		std::cout << "Error initializing SDL: %" << SDL_GetError() << std::endl;
 	} 
@@ -64,7 +127,24 @@ int main()
 	std::vector<SnakeBrain> replaySnakeBrains;
 	int useSnakeBrainGeneration;
 
-	ClSnake::evolve(replaySnakeBrains, useSnakeBrainGeneration);
+	ClSnake::evolve(config, replaySnakeBrains, useSnakeBrainGeneration);
+	if (replaySnakeBrains.empty()) {
+		return 1;
+	}
+
+	if (config.pruning.afterTraining) {
+		SnakeBrain pruned = replaySnakeBrains[useSnakeBrainGeneration].clone();
+		ClSnake::printPruneReport(ClSnake::pruneAndCompare(config, replaySnakeBrains[useSnakeBrainGeneration], pruned));
+		// The pruned weights are saved as zeros
+		replaySnakeBrains[useSnakeBrainGeneration] = pruned;
+	}
+
+	if (replaySnakeBrains[useSnakeBrainGeneration].save(config.evolution.brainOutputPath)) {
+		std::cout << "Saved best brain to " << config.evolution.brainOutputPath << std::endl;
+	}
+	else {
+		std::cout << "Failed to save brain to " << config.evolution.brainOutputPath << std::endl;
+	}
 
 	Game* game = nullptr;
 
@@ -72,12 +152,14 @@ int main()
 	auto freezeUntil = 0.0f;
 	auto waitingForRestart = true;
 
-	auto boardPosToRenderRect = [](Vec2i p) {
+	const int squareSize = SnakeConfiguration::Graphics::squareSize(config.game.numSquares);
+
+	auto boardPosToRenderRect = [squareSize](Vec2i p) {
 		SDL_Rect r;
-		r.x = SnakeConfiguration::Graphics::boardMarginLeft + p.x * SnakeConfiguration::Graphics::squareSize;
-		r.y = SnakeConfiguration::Graphics::boardMarginTop + p.y * SnakeConfiguration::Graphics::squareSize;
-		r.w = SnakeConfiguration::Graphics::squareSize;
-		r.h = SnakeConfiguration::Graphics::squareSize;
+		r.x = SnakeConfiguration::Graphics::boardMarginLeft + p.x * squareSize;
+		r.y = SnakeConfiguration::Graphics::boardMarginTop + p.y * squareSize;
+		r.w = squareSize;
+		r.h = squareSize;
 		return r;
 	};
 
@@ -91,7 +173,7 @@ int main()
 				if (game != nullptr) {
 					delete game;
 				}
-				game = new Game(&replaySnakeBrains[useSnakeBrainGeneration], SnakeConfiguration::Game::numSquares, SnakeConfiguration::Game::numSquares, SnakeConfiguration::Game::roundTime);
+				game = new Game(config, &replaySnakeBrains[useSnakeBrainGeneration], config.game.numSquares, config.game.numSquares, config.game.roundTime);
 				waitingForRestart = false;
 			}
 		}
@@ -99,7 +181,7 @@ int main()
 			if (SDL_GetTicks64() - lastTimeMs > 100) {
 				bool roundDone = false;
 				measureSquares.clear();
-				if (SnakeConfiguration::Game::manualPlay) {
+				if (config.game.manualPlay) {
 					roundDone = !game->playStep(true, &snakeMove, &measureSquares);
 				}
 				else {
@@ -160,8 +242,8 @@ int main()
 
 		SDL_RenderClear(rend);
 		SDL_SetRenderDrawColor(rend, 130, 120, 120, 0);
-		for (int col = 0; col < SnakeConfiguration::Game::numSquares; col++) {
-			for (int row = 0; row < SnakeConfiguration::Game::numSquares; row++) {
+		for (int col = 0; col < config.game.numSquares; col++) {
+			for (int row = 0; row < config.game.numSquares; row++) {
 				auto r = boardPosToRenderRect(Vec2i(col, row));
 				SDL_RenderDrawRect(rend, &r);
 			}
@@ -0,0 +1,194 @@
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+#include "clsnake_inference.h"
+#include "genome_file.h"
+
+struct InferenceLayer {
+	int numInputs;
+	int numOutputs;
+	// numOutputs rows of numInputs weights, same order as in the genome
+	std::vector<float> weights;
+	std::vector<float> biases;
+};
+
+struct clsnake_brain {
+	int numInputs;
+	int maxLayerSize;
+	std::vector<InferenceLayer> layers;
+};
+
+struct clsnake_context {
+	const clsnake_brain* brain;
+	int maxBatchSize;
+	// Activations going in to and out of the current layer, for one chunk of the batch
+	std::vector<float> current;
+	std::vector<float> next;
+};
+
+namespace {
+
+	// Number of batch rows computed together, so each weight row is loaded once for all of them
+	const int rowBlock = 4;
+	// Large batches are run through all layers a chunk at a time, so the activations stay in cache
+	const int batchChunk = 64;
+
+	// out[r][j] = relu(sum_k in[r][k] * w[j][k] + b[j]). The sum runs in the same order as the dense path of
+	//	SnakeBrain::think, and of the sparse form, which only skips zero weights. Brains that trained with the blocked
+	//	form summed in another order, so their outputs can differ in the last bits
+	void forwardLayer(const InferenceLayer& layer, const float* in, float* out, int batchSize) {
+		const int numIn = layer.numInputs;
+		const int numOut = layer.numOutputs;
+		const float* w = layer.weights.data();
+		const float* b = layer.biases.data();
+
+		int row = 0;
+		for (; row + rowBlock <= batchSize; row += rowBlock) {
+			const float* in0 = in + (row + 0) * numIn;
+			const float* in1 = in + (row + 1) * numIn;
+			const float* in2 = in + (row + 2) * numIn;
+			const float* in3 = in + (row + 3) * numIn;
+			for (int j = 0; j < numOut; j++) {
+				const float* wj = w + j * numIn;
+				float s0 = 0;
+				float s1 = 0;
+				float s2 = 0;
+				float s3 = 0;
+				for (int k = 0; k < numIn; k++) {
+					s0 += in0[k] * wj[k];
+					s1 += in1[k] * wj[k];
+					s2 += in2[k] * wj[k];
+					s3 += in3[k] * wj[k];
+				}
+				out[(row + 0) * numOut + j] = std::max(0.0f, s0 + b[j]);
+				out[(row + 1) * numOut + j] = std::max(0.0f, s1 + b[j]);
+				out[(row + 2) * numOut + j] = std::max(0.0f, s2 + b[j]);
+				out[(row + 3) * numOut + j] = std::max(0.0f, s3 + b[j]);
+			}
+		}
+		for (; row < batchSize; row++) {
+			const float* inRow = in + row * numIn;
+			for (int j = 0; j < numOut; j++) {
+				const float* wj = w + j * numIn;
+				float s = 0;
+				for (int k = 0; k < numIn; k++) {
+					s += inRow[k] * wj[k];
+				}
+				out[row * numOut + j] = std::max(0.0f, s + b[j]);
+			}
+		}
+	}
+}
+
+clsnake_brain* clsnake_brain_load(const char* path) {
+	std::ifstream in(path, std::ios::binary);
+	GenomeFileHeader header;
+	const GenomeFileHeader expected;
+
+	if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+		return nullptr;
+	}
+	if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version) {
+		return nullptr;
+	}
+	if (header.numInputs <= 0 || header.numHiddenLayers < 0 || header.hiddenLayerSize <= 0 || header.outputLayerSize <= 0) {
+		return nullptr;
+	}
+
+	std::vector<int> layerSizes;
+	layerSizes.push_back(header.numInputs);
+	for (int i = 0; i < header.numHiddenLayers; i++) {
+		layerSizes.push_back(header.hiddenLayerSize);
+	}
+	layerSizes.push_back(header.outputLayerSize);
+
+	long long expectedGenomeSize = 0;
+	for (size_t i = 1; i < layerSizes.size(); i++) {
+		expectedGenomeSize += static_cast<long long>(layerSizes[i]) * (layerSizes[i - 1] + 1);
+	}
+	if (header.genomeSize != expectedGenomeSize) {
+		return nullptr;
+	}
+
+	std::vector<float> genome(header.genomeSize);
+	if (!in.read(reinterpret_cast<char*>(genome.data()), genome.size() * sizeof(float))) {
+		return nullptr;
+	}
+
+	auto brain = new clsnake_brain();
+	brain->numInputs = header.numInputs;
+	brain->maxLayerSize = *std::max_element(layerSizes.begin(), layerSizes.end());
+
+	int idxGene = 0;
+	for (size_t i = 1; i < layerSizes.size(); i++) {
+		InferenceLayer layer;
+		layer.numInputs = layerSizes[i - 1];
+		layer.numOutputs = layerSizes[i];
+		for (int j = 0; j < layer.numOutputs; j++) {
+			layer.weights.insert(layer.weights.end(), genome.begin() + idxGene, genome.begin() + idxGene + layer.numInputs);
+			idxGene += layer.numInputs;
+			layer.biases.push_back(genome[idxGene++]);
+		}
+		brain->layers.push_back(std::move(layer));
+	}
+
+	return brain;
+}
+
+void clsnake_brain_free(clsnake_brain* brain) {
+	delete brain;
+}
+
+int clsnake_brain_num_inputs(const clsnake_brain* brain) {
+	return brain->numInputs;
+}
+
+clsnake_context* clsnake_context_create(const clsnake_brain* brain, int maxBatchSize) {
+	if (brain == nullptr || maxBatchSize <= 0) {
+		return nullptr;
+	}
+
+	auto context = new clsnake_context();
+	context->brain = brain;
+	context->maxBatchSize = maxBatchSize;
+	context->current.resize(static_cast<size_t>(std::min(maxBatchSize, batchChunk)) * brain->maxLayerSize);
+	context->next.resize(static_cast<size_t>(std::min(maxBatchSize, batchChunk)) * brain->maxLayerSize);
+
+	return context;
+}
+
+void clsnake_context_free(clsnake_context* context) {
+	delete context;
+}
+
+int clsnake_decide(clsnake_context* context, const float* sensors, int batchSize, int* moves) {
+	if (context == nullptr || sensors == nullptr || moves == nullptr || batchSize <= 0 || batchSize > context->maxBatchSize) {
+		return -1;
+	}
+
+	const int numInputs = context->brain->numInputs;
+	const int numOutputs = context->brain->layers.back().numOutputs;
+
+	for (int chunkStart = 0; chunkStart < batchSize; chunkStart += batchChunk) {
+		const int chunkSize = std::min(batchChunk, batchSize - chunkStart);
+		const float* in = sensors + static_cast<size_t>(chunkStart) * numInputs;
+		float* out = context->current.data();
+		float* spare = context->next.data();
+
+		for (auto& layer : context->brain->layers) {
+			forwardLayer(layer, in, out, chunkSize);
+			in = out;
+			std::swap(out, spare);
+		}
+
+		// Same tie breaking as the snake: the first of the largest outputs wins
+		for (int row = 0; row < chunkSize; row++) {
+			const float* outputs = in + row * numOutputs;
+			moves[chunkStart + row] = static_cast<int>(std::max_element(outputs, outputs + numOutputs) - outputs);
+		}
+	}
+
+	return 0;
+}
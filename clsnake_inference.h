@@ -0,0 +1,50 @@
+#pragma once
+
+// Standalone inference for trained snake brains, with a C interface so it can be used from other simulators.
+//	Doesn't depend on any of the training code.
+//
+// Load a brain saved by the training (see genome_file.h), create one context per thread and call
+//	clsnake_decide with a batch of sensor vectors. A context holds all memory needed for batches up to
+//	its max size, so deciding never allocates.
+
+#ifdef _WIN32
+#ifdef CLSNAKE_INFERENCE_EXPORTS
+#define CLSNAKE_API __declspec(dllexport)
+#else
+#define CLSNAKE_API __declspec(dllimport)
+#endif
+#else
+#define CLSNAKE_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	// Moves relative to the current direction of the snake. Same order as the brain outputs
+	enum {
+		CLSNAKE_MOVE_RIGHT = 0,
+		CLSNAKE_MOVE_LEFT = 1,
+		CLSNAKE_MOVE_FORWARD = 2
+	};
+
+	typedef struct clsnake_brain clsnake_brain;
+	typedef struct clsnake_context clsnake_context;
+
+	// Returns NULL if the file can't be read or isn't a saved brain
+	CLSNAKE_API clsnake_brain* clsnake_brain_load(const char* path);
+	CLSNAKE_API void clsnake_brain_free(clsnake_brain* brain);
+	// Number of floats in each sensor vector
+	CLSNAKE_API int clsnake_brain_num_inputs(const clsnake_brain* brain);
+
+	// The brain must outlive the context. A context must only be used by one thread at a time
+	CLSNAKE_API clsnake_context* clsnake_context_create(const clsnake_brain* brain, int maxBatchSize);
+	CLSNAKE_API void clsnake_context_free(clsnake_context* context);
+
+	// sensors holds batchSize sensor vectors after each other; moves gets one CLSNAKE_MOVE_ per vector.
+	//	Returns 0 on success, -1 if a pointer is null or batchSize isn't on range 1 - the maximum of the context
+	CLSNAKE_API int clsnake_decide(clsnake_context* context, const float* sensors, int batchSize, int* moves);
+
+#ifdef __cplusplus
+}
+#endif
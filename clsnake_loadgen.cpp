@@ -0,0 +1,120 @@
+#include <iostream>
+#include <format>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <algorithm>
+#include <string>
+
+#include "clsnake_inference.h"
+
+// Load generator for the inference library: measures the latency of single queries
+//	and the throughput of batches, on one and on all threads.
+//
+// Usage: clsnake_loadgen [brain file] [seconds per test]
+
+using Clock = std::chrono::steady_clock;
+
+// Sensor vectors that look like what Game::measure produces: 8 directions of (1 / wall distance, food, body)
+std::vector<float> makeSensors(int numInputs, int numVectors, std::mt19937& gen) {
+	std::uniform_int_distribution<> distance(1, 20);
+	std::bernoulli_distribution flag(0.2);
+	std::vector<float> sensors(static_cast<size_t>(numInputs) * numVectors);
+
+	for (int i = 0; i < sensors.size(); i++) {
+		sensors[i] = (i % 3 == 0) ? 1.0f / distance(gen) : (flag(gen) ? 1.0f : 0.0f);
+	}
+
+	return sensors;
+}
+
+void runLatency(const clsnake_brain* brain, double seconds) {
+	std::mt19937 gen(1);
+	const int numInputs = clsnake_brain_num_inputs(brain);
+	const int numDistinct = 4096;
+	auto sensors = makeSensors(numInputs, numDistinct, gen);
+	auto context = clsnake_context_create(brain, 1);
+	std::vector<double> latenciesNs;
+	int move = 0;
+
+	auto end = Clock::now() + std::chrono::duration<double>(seconds);
+	for (int i = 0; Clock::now() < end; i++) {
+		auto start = Clock::now();
+		clsnake_decide(context, sensors.data() + (i % numDistinct) * numInputs, 1, &move);
+		latenciesNs.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+	}
+
+	clsnake_context_free(context);
+	std::sort(latenciesNs.begin(), latenciesNs.end());
+
+	auto percentile = [&latenciesNs](double p) {
+		return latenciesNs[std::min(latenciesNs.size() - 1, static_cast<size_t>(p * latenciesNs.size()))] / 1000.0;
+	};
+
+	std::cout << std::format("Single query latency (us) over {} queries\n", latenciesNs.size());
+	std::cout << std::format("p50\tp90\tp99\tp99.9\tmax\n");
+	std::cout << std::format("{:.2f}\t{:.2f}\t{:.2f}\t{:.2f}\t{:.2f}\n\n", percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999), latenciesNs.back() / 1000.0);
+}
+
+// Returns queries (sensor vectors) per second, summed over all threads
+double runThroughput(const clsnake_brain* brain, int batchSize, int numThreads, double seconds) {
+	std::vector<long long> numQueries(numThreads, 0);
+	std::vector<std::thread> threads;
+
+	for (int idxThread = 0; idxThread < numThreads; idxThread++) {
+		threads.push_back(std::thread([brain, batchSize, seconds, idxThread, &numQueries]() {
+			std::mt19937 gen(idxThread + 1);
+			auto sensors = makeSensors(clsnake_brain_num_inputs(brain), batchSize, gen);
+			std::vector<int> moves(batchSize);
+			auto context = clsnake_context_create(brain, batchSize);
+			long long count = 0;
+
+			auto end = Clock::now() + std::chrono::duration<double>(seconds);
+			while (Clock::now() < end) {
+				clsnake_decide(context, sensors.data(), batchSize, moves.data());
+				count += batchSize;
+			}
+
+			clsnake_context_free(context);
+			numQueries[idxThread] = count;
+			}));
+	}
+
+	for (auto& t : threads) {
+		t.join();
+	}
+
+	long long total = 0;
+	for (auto n : numQueries) {
+		total += n;
+	}
+
+	return total / seconds;
+}
+
+int main(int argc, char** argv) {
+	const char* path = (argc > 1) ? argv[1] : "snake_brain.bin";
+	double seconds = (argc > 2) ? std::stod(argv[2]) : 2.0;
+
+	auto brain = clsnake_brain_load(path);
+	if (brain == nullptr) {
+		std::cout << "Failed to load brain from " << path << std::endl;
+		return 1;
+	}
+
+	const int numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	runLatency(brain, seconds);
+
+	std::cout << std::format("Throughput (queries/s)\nBatch\t1 thread\t{} threads\n", numThreads);
+	for (int batchSize : { 1, 16, 256, 4096 }) {
+		double single = runThroughput(brain, batchSize, 1, seconds);
+		double all = runThroughput(brain, batchSize, numThreads, seconds);
+		std::cout << std::format("{}\t{:.0f}\t{:.0f}\n", batchSize, single, all);
+	}
+
+	clsnake_brain_free(brain);
+
+	return 0;
+}
@@ -0,0 +1,523 @@
+#include <iostream>
+#include <format>
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <random>
+#include <span>
+#include <cmath>
+#include <algorithm>
+
+#include "config.h"
+#include "sensor.h"
+#include "game.h"
+#include "snake.h"
+#include "utils.h"
+#include "decision_cache.h"
+#include "evaluation.h"
+#include "worker_pool.h"
+#include "trajectory_recorder.h"
+#include "trajectory_file.h"
+#include "sparse_brain.h"
+#include "blocked_brain.h"
+#include "pruning.h"
+
+// Checks that the faster versions of things give the same results as the plain versions they replace.
+//
+// Usage: clsnake_tests
+//
+// Returns 0 if all checks pass
+
+using namespace ClSnake;
+
+namespace {
+	int numChecks = 0;
+	int numFailed = 0;
+
+	void check(bool ok, const std::string& what) {
+		numChecks++;
+		if (!ok) {
+			numFailed++;
+			std::cout << std::format("FAILED: {}\n", what);
+		}
+	}
+
+	SnakeBrain makeBrain(const SnakeConfiguration& config) {
+		return SnakeBrain(config.numInputs(), config.brain.numHiddenLayers, config.brain.hiddenLayerSize, config.brain.outputLayerSize);
+	}
+
+	// Sensor vectors like the ones the rays give: 1 / distance to the wall, then food and body flags
+	std::vector<float> makeInputs(int numInputs, std::mt19937& gen) {
+		std::uniform_int_distribution<> distance(1, 20);
+		std::bernoulli_distribution flag(0.2);
+		std::vector<float> inputs(numInputs);
+
+		for (int i = 0; i < numInputs; i++) {
+			inputs[i] = (i % 3 == 0) ? 1.0f / distance(gen) : (flag(gen) ? 1.0f : 0.0f);
+		}
+
+		return inputs;
+	}
+
+	// Same brain without its compiled forms, so it thinks the plain way
+	SnakeBrain plainCopy(SnakeBrain& brain) {
+		return SnakeBrain(brain.perceptrons, brain.numInputs, brain.numHiddenLayers, brain.hiddenLayerSize, brain.outputLayerSize);
+	}
+
+	struct GameResult {
+		int fitness;
+		int steps;
+	};
+
+	// Same seed, same food positions, so two brains that decide the same get the same result
+	GameResult playGame(const SnakeConfiguration& config, SnakeBrain& brain, unsigned int seed) {
+		setRandomSeed(seed);
+		Game game(config, &brain, config.game.numSquares, config.game.numSquares, config.game.trainingRoundTime);
+		game.play();
+
+		return { game.fitness(), game.stepsPlayed() };
+	}
+
+	bool sameSquares(const std::vector<Vec2i>& a, const std::vector<Vec2i>& b) {
+		return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](Vec2i p, Vec2i q) {return p == q; });
+	}
+
+	bool sameSquares(const MeasureSquares& a, const MeasureSquares& b) {
+		return sameSquares(a.body, b.body) && sameSquares(a.food, b.food) && sameSquares(a.wall, b.wall);
+	}
+
+	// What the snake saw and where it went, step by step
+	struct SeenGame {
+		std::vector<MeasureSquares> squares;
+		std::vector<Vec2i> positions;
+	};
+
+	// Same seed, same food positions, as long as the moves are the same. The food is placed with the random numbers
+	//	of the thread, so two games compared step by step have to be played one after the other
+	SeenGame playSeenGame(const SnakeConfiguration& config, SnakeBrain& brain, unsigned int seed) {
+		SeenGame seen;
+		setRandomSeed(seed);
+		Game game(config, &brain, config.game.numSquares, config.game.numSquares, config.game.trainingRoundTime);
+
+		bool goOn = true;
+		while (goOn) {
+			seen.squares.emplace_back();
+			goOn = game.playStep(false, nullptr, &seen.squares.back());
+			seen.positions.push_back(game.snake->position);
+		}
+
+		return seen;
+	}
+
+	// The incremental rays must see exactly what walking each ray from scratch sees. A game with each, with the same
+	//	brain and seed, must see the same squares and make the same moves all the way
+	void testRaySensorMatchesWalk() {
+		for (int numSquares : {8, 20, Sensor::maxBoardSize}) {
+			SnakeConfiguration config;
+			config.game.numSquares = numSquares;
+			SnakeConfiguration walkConfig = config;
+			walkConfig.game.incrementalSensing = false;
+			int numDifferent = 0;
+
+			for (unsigned int idxBrain = 0; idxBrain < 20; idxBrain++) {
+				auto brain = makeBrain(config);
+				auto seen = playSeenGame(config, brain, idxBrain);
+				auto walkSeen = playSeenGame(walkConfig, brain, idxBrain);
+				bool same = std::equal(seen.squares.begin(), seen.squares.end(), walkSeen.squares.begin(), walkSeen.squares.end(),
+					[](const MeasureSquares& a, const MeasureSquares& b) {return sameSquares(a, b); });
+				numDifferent += !same || !sameSquares(seen.positions, walkSeen.positions);
+			}
+			check(numDifferent == 0, std::format("Ray sensor: {} of 20 games on {} x {} differed from the walk", numDifferent, numSquares, numSquares));
+		}
+	}
+
+	// The masks must give what looking at one square at a time gives, in all four directions, also after the snake
+	//	has moved: the body grows at the head and shrinks at the tail, so bits are both set and cleared
+	void testWindowSensorMatchesFull() {
+		std::mt19937 gen(5);
+		SnakeConfiguration config;
+		auto brain = makeBrain(config);
+		const SnakeDirection directions[] = { SnakeDirection::Up, SnakeDirection::Right, SnakeDirection::Down, SnakeDirection::Left };
+		const Vec2i steps[] = { Vec2i(0, -1), Vec2i(1, 0), Vec2i(0, 1), Vec2i(-1, 0) };
+
+		for (int numSquares : {8, 20, 50}) {
+			for (int windowSize : {3, 7, 9, 13}) {
+				WindowSensor sensor(numSquares, numSquares, windowSize);
+				Snake snake(&brain, Vec2i(numSquares / 2, numSquares / 2));
+				sensor.reset(&snake);
+				std::uniform_int_distribution<> square(0, numSquares - 1);
+				std::uniform_int_distribution<> pickStep(0, 3);
+				std::pmr::vector<float> measurements;
+				std::pmr::vector<float> fullMeasurements;
+				int numDifferent = 0;
+
+				for (int i = 0; i < 400; i++) {
+					// Random walk of the head. Every other step the tail follows, so the snake slowly grows
+					Vec2i next = snake.position + steps[pickStep(gen)];
+					bool onBoard = next.x >= 0 && next.x < numSquares && next.y >= 0 && next.y < numSquares;
+					if (!onBoard || sensor.isBody(next)) {
+						continue;
+					}
+					snake.body.push_back(next);
+					snake.position = next;
+					sensor.addBody(next);
+					if (i % 2 == 0) {
+						sensor.removeBody(snake.body.front());
+						snake.body.erase(snake.body.begin());
+					}
+
+					Vec2i food(square(gen), square(gen));
+					for (auto direction : directions) {
+						snake.direction = direction;
+						MeasureSquares squares;
+						MeasureSquares fullSquares;
+						sensor.measure(&snake, food, measurements, &squares);
+						sensor.measureFull(&snake, food, fullMeasurements, &fullSquares);
+						const size_t numInputs = sensor.numInputs();
+						bool same = measurements.size() >= numInputs && fullMeasurements.size() >= numInputs
+							&& std::equal(measurements.begin(), measurements.begin() + numInputs, fullMeasurements.begin());
+						numDifferent += !same || !sameSquares(squares, fullSquares);
+					}
+				}
+				check(numDifferent == 0, std::format("Window sensor: {} of the measurements of a {} window on {} x {} differed", numDifferent, windowSize, numSquares, numSquares));
+			}
+		}
+	}
+
+	void testDecisionCacheStoresMoves() {
+		DecisionCache cache(64);
+		SnakeMove move = SnakeMove::Forward;
+
+		check(!cache.find(1234, move), "Decision cache: empty cache misses");
+		cache.insert(1234, SnakeMove::Left);
+		check(cache.find(1234, move) && move == SnakeMove::Left, "Decision cache: finds an inserted move");
+		cache.insert(1234, SnakeMove::Right);
+		check(cache.find(1234, move) && move == SnakeMove::Right, "Decision cache: a new move replaces the old");
+		check(!cache.find(4321, move), "Decision cache: other keys miss");
+		cache.clear();
+		check(!cache.find(1234, move), "Decision cache: misses after clear");
+
+		long long hits = 0;
+		long long misses = 0;
+		cache.takeStats(hits, misses);
+		check(hits == 2 && misses == 3, std::format("Decision cache: counts 2 hits and 3 misses, got {} and {}", hits, misses));
+	}
+
+	// Many threads inserting and looking up the same keys never see a move that wasn't stored for the key
+	void testDecisionCacheSharedBetweenThreads() {
+		DecisionCache cache(256);
+		const int numThreads = 8;
+		const int numKeys = 1024;
+		std::vector<int> numWrong(numThreads, 0);
+		std::vector<std::thread> threads;
+
+		for (int idxThread = 0; idxThread < numThreads; idxThread++) {
+			threads.emplace_back([&cache, &numWrong, idxThread]() {
+				for (int i = 0; i < 20000; i++) {
+					uint64_t key = (i * 7919 + idxThread) % numKeys;
+					SnakeMove move;
+					if (cache.find(key, move)) {
+						numWrong[idxThread] += move != static_cast<SnakeMove>(key % 3);
+					}
+					else {
+						cache.insert(key, static_cast<SnakeMove>(key % 3));
+					}
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+
+		int totalWrong = 0;
+		for (int n : numWrong) {
+			totalWrong += n;
+		}
+		check(totalWrong == 0, std::format("Decision cache: {} lookups from several threads returned the wrong move", totalWrong));
+	}
+
+	// A brain with a cache must play exactly like the same brain without one, both when it misses and when it hits
+	void testDecisionCacheKeepsGames() {
+		SnakeConfiguration config;
+
+		for (int idxBrain = 0; idxBrain < 20; idxBrain++) {
+			auto brain = makeBrain(config);
+			auto cachedBrain = brain.clone();
+			cachedBrain.setDecisionCache(4096);
+
+			for (unsigned int seed = 1; seed <= 3; seed++) {
+				auto expected = playGame(config, brain, seed);
+				// The first game fills the cache, the second plays the same states again
+				for (int round = 0; round < 2; round++) {
+					auto result = playGame(config, cachedBrain, seed);
+					check(result.fitness == expected.fitness && result.steps == expected.steps,
+						std::format("Decision cache: brain {} seed {} round {} got fitness {} instead of {}", idxBrain, seed, round, result.fitness, expected.fitness));
+				}
+			}
+		}
+
+		// New weights must not reuse the decisions of the old ones
+		for (int idxBrain = 0; idxBrain < 10; idxBrain++) {
+			auto brain = makeBrain(config);
+			brain.setDecisionCache(4096);
+			playGame(config, brain, 1);
+			auto other = makeBrain(config);
+			brain.setGenome(other.toGenome());
+			// Random brains mostly circle until the time is up, so compare the moves rather than the fitness
+			auto expected = playSeenGame(config, other, 1);
+			auto result = playSeenGame(config, brain, 1);
+			check(sameSquares(result.positions, expected.positions), std::format("Decision cache: brain {} with a new genome didn't move like its new weights", idxBrain));
+		}
+
+		// Every game is played again with the same seed, so the cache must have been used
+		auto brain = makeBrain(config);
+		brain.setDecisionCache(4096);
+		playGame(config, brain, 1);
+		playGame(config, brain, 1);
+		long long hits = 0;
+		long long misses = 0;
+		brain.decisionCache()->takeStats(hits, misses);
+		check(hits > 0, std::format("Decision cache: a replayed game got {} hits and {} misses", hits, misses));
+	}
+
+	// Zero weights are skipped in the same order as the plain think adds them, so the outputs are bit for bit the same.
+	//	Hidden neurons without outgoing weights are left out, and read as 0
+	void testSparseBrainMatchesDense() {
+		std::mt19937 gen(3);
+		std::bernoulli_distribution keepWeight(0.4);
+
+		for (int numHiddenLayers : {1, 2, 3}) {
+			SnakeConfiguration config;
+			config.brain.numHiddenLayers = numHiddenLayers;
+			auto brain = makeBrain(config);
+			const int hiddenSize = config.brain.hiddenLayerSize;
+
+			// The outputs only have three weights from each neuron, so they keep all of them. Otherwise some neurons
+			//	would lose all their outgoing weights by chance
+			const int numHiddenPerceptrons = numHiddenLayers * hiddenSize;
+			brain.weightsChanged();
+			for (int idx = 0; idx < numHiddenPerceptrons; idx++) {
+				auto perceptron = brain.mutablePerceptron(idx);
+				for (auto& w : perceptron->w) {
+					w = keepWeight(gen) ? w : 0.0f;
+				}
+			}
+			// Neurons 0 and 5 of each hidden layer can't affect anything
+			for (int idx = hiddenSize; idx < static_cast<int>(brain.perceptrons.size()); idx++) {
+				auto perceptron = brain.mutablePerceptron(idx);
+				perceptron->w[0] = 0.0f;
+				perceptron->w[5] = 0.0f;
+			}
+
+			SparseBrain sparse(brain);
+			check(sparse.numHiddenNeurons() == numHiddenLayers * (hiddenSize - 2), std::format("Sparse brain: {} hidden layers keep {} neurons", numHiddenLayers, sparse.numHiddenNeurons()));
+
+			ThinkBuffers denseBuffers;
+			ThinkBuffers sparseBuffers;
+			denseBuffers.keepHidden = true;
+			sparseBuffers.keepHidden = true;
+			int numDifferent = 0;
+			for (int i = 0; i < 1000; i++) {
+				auto inputs = makeInputs(brain.numInputs, gen);
+				auto denseOutputs = brain.think(inputs, denseBuffers);
+				auto sparseOutputs = sparse.think(inputs, sparseBuffers);
+				numDifferent += !std::equal(denseOutputs.begin(), denseOutputs.end(), sparseOutputs.begin(), sparseOutputs.end());
+				for (int j = 0; j < static_cast<int>(denseBuffers.hidden.size()); j++) {
+					bool leftOut = j % hiddenSize == 0 || j % hiddenSize == 5;
+					numDifferent += sparseBuffers.hidden[j] != (leftOut ? 0.0f : denseBuffers.hidden[j]);
+				}
+			}
+			check(numDifferent == 0, std::format("Sparse brain: {} hidden layers gave {} different values", numHiddenLayers, numDifferent));
+		}
+	}
+
+	// A pruned brain plays exactly like the same weights thinking the plain way
+	void testPrunedBrainPlaysTheSame() {
+		SnakeConfiguration config;
+		config.pruning.weightThreshold = 0.3f;
+
+		for (int idxBrain = 0; idxBrain < 10; idxBrain++) {
+			auto brain = makeBrain(config);
+			prune(config, brain);
+			check(brain.sparseBrain() != nullptr, "Sparse brain: pruning compiles the brain");
+			auto plain = plainCopy(brain);
+
+			for (unsigned int seed = 1; seed <= 3; seed++) {
+				auto expected = playGame(config, plain, seed);
+				auto result = playGame(config, brain, seed);
+				check(result.fitness == expected.fitness && result.steps == expected.steps,
+					std::format("Sparse brain: brain {} seed {} got fitness {} instead of {}", idxBrain, seed, result.fitness, expected.fitness));
+			}
+		}
+	}
+
+	// The blocked brain adds in another order, so the last bits may differ
+	bool isClose(float a, float b) {
+		return std::abs(a - b) <= 1e-4f * std::max(1.0f, std::abs(b));
+	}
+
+	// Widths that fill the panels exactly and ones that need padding, and one wide enough to split over the pool
+	void testBlockedBrainMatchesDense() {
+		std::mt19937 gen(4);
+		ClSnake::WorkerPool pool(4);
+
+		for (int hiddenSize : {16, 20, 100, 256}) {
+			for (int numHiddenLayers : {1, 2}) {
+				SnakeConfiguration config;
+				config.brain.hiddenLayerSize = hiddenSize;
+				config.brain.numHiddenLayers = numHiddenLayers;
+				auto brain = makeBrain(config);
+				BlockedBrain blocked(brain);
+				const int numOutputs = config.brain.outputLayerSize;
+				ThinkBuffers denseBuffers;
+				ThinkBuffers blockedBuffers;
+				ThinkBuffers pooledBuffers;
+				int numDifferent = 0;
+
+				// Batch sizes around the batch tile, so the leftover inputs are covered
+				for (int batchSize = 1; batchSize <= 2 * BlockedBrain::batchTile + 1; batchSize++) {
+					std::vector<float> batch;
+					std::vector<float> expected;
+					for (int i = 0; i < batchSize; i++) {
+						auto inputs = makeInputs(brain.numInputs, gen);
+						auto denseOutputs = brain.think(inputs, denseBuffers);
+						expected.insert(expected.end(), denseOutputs.begin(), denseOutputs.end());
+						batch.insert(batch.end(), inputs.begin(), inputs.end());
+
+						auto blockedOutputs = blocked.think(inputs, blockedBuffers);
+						auto pooledOutputs = blocked.think(inputs, pooledBuffers, pool);
+						for (int j = 0; j < numOutputs; j++) {
+							numDifferent += !isClose(blockedOutputs[j], denseOutputs[j]);
+							numDifferent += !isClose(pooledOutputs[j], denseOutputs[j]);
+						}
+					}
+
+					std::vector<float> outputs;
+					blocked.thinkBatch(batch, batchSize, blockedBuffers, outputs);
+					for (int j = 0; j < batchSize * numOutputs; j++) {
+						numDifferent += !isClose(outputs[j], expected[j]);
+					}
+				}
+				check(numDifferent == 0, std::format("Blocked brain: {} x {} hidden gave {} different outputs", numHiddenLayers, hiddenSize, numDifferent));
+			}
+		}
+	}
+
+	struct TrajectoryRow {
+		uint32_t game;
+		uint32_t step;
+		int32_t reward;
+		bool done;
+	};
+
+	// Reads the rows of a file written by TrajectoryRecorder, in file order. Returns false if the file is malformed
+	bool readTrajectories(const std::string& path, int numInputs, int numHidden, std::vector<TrajectoryRow>& rows) {
+		std::ifstream in(path, std::ios::binary);
+		std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		TrajectoryFileHeader fileHeader;
+
+		if (bytes.size() < sizeof(fileHeader)) {
+			return false;
+		}
+		std::memcpy(&fileHeader, bytes.data(), sizeof(fileHeader));
+		if (std::memcmp(fileHeader.magic, "CLST", 4) != 0 || fileHeader.numInputs != numInputs || fileHeader.numHidden != numHidden) {
+			return false;
+		}
+
+		uint64_t offset = trajectoryAlignment;
+		while (offset < bytes.size()) {
+			TrajectoryBatchHeader header;
+			if (offset % trajectoryAlignment != 0 || offset + sizeof(header) > bytes.size()) {
+				return false;
+			}
+			std::memcpy(&header, bytes.data() + offset, sizeof(header));
+			if (std::memcmp(header.magic, "BATC", 4) != 0 || offset + header.batchBytes > bytes.size()) {
+				return false;
+			}
+
+			auto column = [&](int idxColumn, int idxRow, size_t rowBytes) { return bytes.data() + offset + header.columnOffsets[idxColumn] + idxRow * rowBytes; };
+			for (int i = 0; i < static_cast<int>(header.numRows); i++) {
+				TrajectoryRow row;
+				std::memcpy(&row.game, column(0, i, sizeof(uint32_t)), sizeof(uint32_t));
+				std::memcpy(&row.step, column(1, i, sizeof(uint32_t)), sizeof(uint32_t));
+				std::memcpy(&row.reward, column(5, i, sizeof(int32_t)), sizeof(int32_t));
+				row.done = *column(6, i, 1) != 0;
+				rows.push_back(row);
+			}
+			offset += header.batchBytes;
+		}
+
+		return offset == bytes.size();
+	}
+
+	// Records every game of a population played in slices, so the games move between workers, with batches much
+	//	smaller than a game. Each game must still be in the file in order, step by step, ending with its last step
+	void testTrajectoryRoundTrip() {
+		SnakeConfiguration config;
+		config.evolution.numSnakeBrains = 60;
+		config.evaluation.sliceSteps = 5;
+		const int numHidden = config.brain.numHiddenLayers * config.brain.hiddenLayerSize;
+		const std::string path = (std::filesystem::temp_directory_path() / "clsnake_tests_trajectories.bin").string();
+		size_t numRecorded = 0;
+
+		{
+			WorkerPool pool(4);
+			TrajectoryRecorder recorder(path, config.numInputs(), numHidden, 1, 7, pool.size());
+			check(recorder.isOpen(), "Trajectories: open " + path);
+
+			std::vector<SnakeBrain> brains;
+			for (int i = 0; i < config.evolution.numSnakeBrains; i++) {
+				brains.push_back(makeBrain(config));
+			}
+			std::vector<int> fitness(brains.size());
+			EvaluationStats stats;
+			for (int generation = 0; generation < 2; generation++) {
+				evaluatePopulation(config, pool, brains, fitness, stats, &recorder);
+			}
+			numRecorded = recorder.numRecordedSteps();
+		}
+
+		std::vector<TrajectoryRow> rows;
+		check(readTrajectories(path, config.numInputs(), numHidden, rows), "Trajectories: the file can be read back");
+		check(rows.size() == numRecorded, std::format("Trajectories: {} rows in the file, {} recorded", rows.size(), numRecorded));
+
+		std::vector<uint32_t> nextStep(2 * config.evolution.numSnakeBrains, 0);
+		std::vector<bool> ended(nextStep.size(), false);
+		int numOutOfOrder = 0;
+		for (auto& row : rows) {
+			if (row.game >= nextStep.size() || ended[row.game] || row.step != nextStep[row.game]) {
+				numOutOfOrder++;
+				continue;
+			}
+			nextStep[row.game]++;
+			ended[row.game] = row.done;
+		}
+		check(numOutOfOrder == 0, std::format("Trajectories: {} steps out of order", numOutOfOrder));
+		check(std::find(ended.begin(), ended.end(), false) == ended.end(), "Trajectories: every game ends with its last step");
+
+		std::filesystem::remove(path);
+	}
+}
+
+int main() {
+	testRaySensorMatchesWalk();
+	testWindowSensorMatchesFull();
+	testDecisionCacheStoresMoves();
+	testDecisionCacheSharedBetweenThreads();
+	testDecisionCacheKeepsGames();
+	testTrajectoryRoundTrip();
+	testSparseBrainMatchesDense();
+	testPrunedBrainPlaysTheSame();
+	testBlockedBrainMatchesDense();
+
+	if (numFailed > 0) {
+		std::cout << std::format("{} of {} checks failed\n", numFailed, numChecks);
+		return 1;
+	}
+
+	std::cout << std::format("All {} checks passed\n", numChecks);
+	return 0;
+}
@@ -0,0 +1,278 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <functional>
+#include <map>
+
+#include "config.h"
+#include "sensor.h"
+
+namespace {
+
+	std::string trim(const std::string& s) {
+		auto first = s.find_first_not_of(" \t\r\n");
+		if (first == std::string::npos) {
+			return "";
+		}
+		auto last = s.find_last_not_of(" \t\r\n");
+		return s.substr(first, last - first + 1);
+	}
+
+	// The parse functions throw on bad values; set() turns that into an error message
+	int parseInt(const std::string& value) {
+		size_t numParsed = 0;
+		int v = std::stoi(value, &numParsed);
+		if (numParsed != value.size()) {
+			throw std::invalid_argument(value);
+		}
+		return v;
+	}
+
+	float parseFloat(const std::string& value) {
+		size_t numParsed = 0;
+		float v = std::stof(value, &numParsed);
+		if (numParsed != value.size()) {
+			throw std::invalid_argument(value);
+		}
+		return v;
+	}
+
+	bool parseBool(const std::string& value) {
+		if (value == "true" || value == "1") {
+			return true;
+		}
+		if (value == "false" || value == "0") {
+			return false;
+		}
+		throw std::invalid_argument(value);
+	}
+
+	std::vector<int> parseIntList(const std::string& value) {
+		std::vector<int> list;
+		std::stringstream ss(value);
+		std::string item;
+		while (std::getline(ss, item, ',')) {
+			list.push_back(parseInt(trim(item)));
+		}
+		if (list.empty()) {
+			throw std::invalid_argument(value);
+		}
+		return list;
+	}
+
+	template<typename T>
+	T parseEnum(const std::string& value, const std::map<std::string, T>& names) {
+		auto iter = names.find(value);
+		if (iter == names.end()) {
+			throw std::invalid_argument(value);
+		}
+		return iter->second;
+	}
+
+	using Setter = std::function<void(SnakeConfiguration&, const std::string&)>;
+
+	const std::map<std::string, Setter>& setters() {
+		static const std::map<std::string, Setter> table = {
+			{ "game.numSquares", [](SnakeConfiguration& c, const std::string& v) { c.game.numSquares = parseInt(v); } },
+			{ "game.timeUnitScore", [](SnakeConfiguration& c, const std::string& v) { c.game.timeUnitScore = parseInt(v); } },
+			{ "game.foodScore", [](SnakeConfiguration& c, const std::string& v) { c.game.foodScore = parseInt(v); } },
+			{ "game.foodTimeAdd", [](SnakeConfiguration& c, const std::string& v) { c.game.foodTimeAdd = parseInt(v); } },
+			{ "game.manualPlay", [](SnakeConfiguration& c, const std::string& v) { c.game.manualPlay = parseBool(v); } },
+			{ "game.roundTime", [](SnakeConfiguration& c, const std::string& v) { c.game.roundTime = parseInt(v); } },
+			{ "game.trainingRoundTime", [](SnakeConfiguration& c, const std::string& v) { c.game.trainingRoundTime = parseInt(v); } },
+			{ "game.incrementalSensing", [](SnakeConfiguration& c, const std::string& v) { c.game.incrementalSensing = parseBool(v); } },
+			{ "game.sensor", [](SnakeConfiguration& c, const std::string& v) {
+				c.game.sensor = parseEnum<SensorType>(v, { { "Rays", SensorType::Rays }, { "Window", SensorType::Window } }); } },
+			{ "game.windowSize", [](SnakeConfiguration& c, const std::string& v) { c.game.windowSize = parseInt(v); } },
+			{ "brain.numHiddenLayers", [](SnakeConfiguration& c, const std::string& v) { c.brain.numHiddenLayers = parseInt(v); } },
+			{ "brain.hiddenLayerSize", [](SnakeConfiguration& c, const std::string& v) { c.brain.hiddenLayerSize = parseInt(v); } },
+			{ "brain.decisionCacheSize", [](SnakeConfiguration& c, const std::string& v) { c.brain.decisionCacheSize = parseInt(v); } },
+			{ "brain.blockedMinLayerSize", [](SnakeConfiguration& c, const std::string& v) { c.brain.blockedMinLayerSize = parseInt(v); } },
+			{ "evolution.numSnakeBrains", [](SnakeConfiguration& c, const std::string& v) { c.evolution.numSnakeBrains = parseInt(v); } },
+			{ "evolution.partOfParentsUsedForCrossover", [](SnakeConfiguration& c, const std::string& v) { c.evolution.partOfParentsUsedForCrossover = parseFloat(v); } },
+			{ "evolution.mutationProbability", [](SnakeConfiguration& c, const std::string& v) { c.evolution.mutationProbability = parseFloat(v); } },
+			{ "evolution.numGenerations", [](SnakeConfiguration& c, const std::string& v) { c.evolution.numGenerations = parseInt(v); } },
+			{ "evolution.optimizer", [](SnakeConfiguration& c, const std::string& v) {
+				c.evolution.optimizer = parseEnum<OptimizerType>(v, { { "Genetic", OptimizerType::Genetic }, { "EvolutionStrategy", OptimizerType::EvolutionStrategy } }); } },
+			{ "evolution.mode", [](SnakeConfiguration& c, const std::string& v) {
+				c.evolution.mode = parseEnum<EvolutionMode>(v, { { "Generational", EvolutionMode::Generational }, { "SteadyState", EvolutionMode::SteadyState } }); } },
+			{ "evolution.reevaluateEvery", [](SnakeConfiguration& c, const std::string& v) { c.evolution.reevaluateEvery = parseInt(v); } },
+			{ "evolution.targetFitness", [](SnakeConfiguration& c, const std::string& v) { c.evolution.targetFitness = parseInt(v); } },
+			{ "evolution.brainOutputPath", [](SnakeConfiguration& c, const std::string& v) { c.evolution.brainOutputPath = v; } },
+			{ "evolution.printProgress", [](SnakeConfiguration& c, const std::string& v) { c.evolution.printProgress = parseBool(v); } },
+			{ "evaluation.successiveHalving", [](SnakeConfiguration& c, const std::string& v) { c.evaluation.successiveHalving = parseBool(v); } },
+			{ "evaluation.rungSteps", [](SnakeConfiguration& c, const std::string& v) { c.evaluation.rungSteps = parseIntList(v); } },
+			{ "evaluation.rungEpisodes", [](SnakeConfiguration& c, const std::string& v) { c.evaluation.rungEpisodes = parseIntList(v); } },
+			{ "evaluation.rungKeepFraction", [](SnakeConfiguration& c, const std::string& v) { c.evaluation.rungKeepFraction = parseFloat(v); } },
+			{ "evaluation.longestFirst", [](SnakeConfiguration& c, const std::string& v) { c.evaluation.longestFirst = parseBool(v); } },
+			{ "evaluation.sliceSteps", [](SnakeConfiguration& c, const std::string& v) { c.evaluation.sliceSteps = parseInt(v); } },
+			{ "population.outOfCore", [](SnakeConfiguration& c, const std::string& v) { c.population.outOfCore = parseBool(v); } },
+			{ "population.path1", [](SnakeConfiguration& c, const std::string& v) { c.population.path1 = v; } },
+			{ "population.path2", [](SnakeConfiguration& c, const std::string& v) { c.population.path2 = v; } },
+			{ "population.memoryBudgetMB", [](SnakeConfiguration& c, const std::string& v) { c.population.memoryBudgetMB = parseInt(v); } },
+			{ "record.enabled", [](SnakeConfiguration& c, const std::string& v) { c.record.enabled = parseBool(v); } },
+			{ "record.everyNthGame", [](SnakeConfiguration& c, const std::string& v) { c.record.everyNthGame = parseInt(v); } },
+			{ "record.batchRows", [](SnakeConfiguration& c, const std::string& v) { c.record.batchRows = parseInt(v); } },
+			{ "record.outputPath", [](SnakeConfiguration& c, const std::string& v) { c.record.outputPath = v; } },
+			{ "pruning.afterTraining", [](SnakeConfiguration& c, const std::string& v) { c.pruning.afterTraining = parseBool(v); } },
+			{ "pruning.elites", [](SnakeConfiguration& c, const std::string& v) { c.pruning.elites = parseBool(v); } },
+			{ "pruning.weightThreshold", [](SnakeConfiguration& c, const std::string& v) { c.pruning.weightThreshold = parseFloat(v); } },
+			{ "pruning.numProbeGames", [](SnakeConfiguration& c, const std::string& v) { c.pruning.numProbeGames = parseInt(v); } },
+			{ "threads.numThreads", [](SnakeConfiguration& c, const std::string& v) { c.threads.numThreads = parseInt(v); } },
+			{ "threads.affinity", [](SnakeConfiguration& c, const std::string& v) {
+				c.threads.affinity = parseEnum<ThreadAffinity>(v, { { "None", ThreadAffinity::None }, { "Core", ThreadAffinity::Core }, { "NumaNode", ThreadAffinity::NumaNode } }); } },
+			{ "threads.arenaBytes", [](SnakeConfiguration& c, const std::string& v) { c.threads.arenaBytes = parseInt(v); } },
+			{ "trace.stepSampleEvery", [](SnakeConfiguration& c, const std::string& v) { c.trace.stepSampleEvery = parseInt(v); } },
+			{ "trace.outputPath", [](SnakeConfiguration& c, const std::string& v) { c.trace.outputPath = v; } },
+			{ "evolutionStrategy.populationSize", [](SnakeConfiguration& c, const std::string& v) { c.evolutionStrategy.populationSize = parseInt(v); } },
+			{ "evolutionStrategy.sigma", [](SnakeConfiguration& c, const std::string& v) { c.evolutionStrategy.sigma = parseFloat(v); } },
+			{ "evolutionStrategy.learningRate", [](SnakeConfiguration& c, const std::string& v) { c.evolutionStrategy.learningRate = parseFloat(v); } },
+		};
+		return table;
+	}
+}
+
+bool SnakeConfiguration::set(const std::string& key, const std::string& value) {
+	auto iter = setters().find(key);
+
+	if (iter == setters().end()) {
+		std::cout << "Unknown configuration key: " << key << std::endl;
+		return false;
+	}
+
+	try {
+		iter->second(*this, value);
+	}
+	catch (const std::exception&) {
+		std::cout << "Bad value for " << key << ": " << value << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool SnakeConfiguration::loadFile(const std::string& path) {
+	std::ifstream in(path);
+
+	if (!in) {
+		std::cout << "Failed to open configuration file " << path << std::endl;
+		return false;
+	}
+
+	std::string line;
+	bool ok = true;
+
+	while (std::getline(in, line)) {
+		line = trim(line);
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		auto eq = line.find('=');
+		if (eq == std::string::npos) {
+			std::cout << "Expected key = value: " << line << std::endl;
+			ok = false;
+			continue;
+		}
+		ok = set(trim(line.substr(0, eq)), trim(line.substr(eq + 1))) && ok;
+	}
+
+	return ok;
+}
+
+bool SnakeConfiguration::apply(const std::string& settings) {
+	// Join "key = value" into "key=value" first, so we can split on whitespace
+	std::string joined;
+	for (size_t i = 0; i < settings.size(); i++) {
+		if (settings[i] == '=') {
+			while (!joined.empty() && (joined.back() == ' ' || joined.back() == '\t')) {
+				joined.pop_back();
+			}
+			joined += '=';
+			while (i + 1 < settings.size() && (settings[i + 1] == ' ' || settings[i + 1] == '\t')) {
+				i++;
+			}
+		}
+		else {
+			joined += settings[i];
+		}
+	}
+
+	std::stringstream ss(joined);
+	std::string setting;
+	bool ok = true;
+
+	while (ss >> setting) {
+		auto eq = setting.find('=');
+		if (eq == std::string::npos) {
+			std::cout << "Expected key=value: " << setting << std::endl;
+			ok = false;
+			continue;
+		}
+		ok = set(setting.substr(0, eq), setting.substr(eq + 1)) && ok;
+	}
+
+	return ok;
+}
+
+bool SnakeConfiguration::validate() const {
+	bool ok = true;
+	auto check = [&ok](bool valid, const char* key, const char* requirement) {
+		if (!valid) {
+			std::cout << "Bad value for " << key << ": must be " << requirement << std::endl;
+			ok = false;
+		}
+	};
+
+	check(game.numSquares >= 2, "game.numSquares", "at least 2");
+	check(game.roundTime >= 1, "game.roundTime", "at least 1");
+	check(game.trainingRoundTime >= 1, "game.trainingRoundTime", "at least 1");
+	// The head is in the middle of the window, and a row of the window is cut out of one 64 bit line
+	check(game.sensor != SensorType::Window || (game.windowSize % 2 == 1 && game.windowSize >= 3 && game.windowSize < Sensor::maxBoardSize),
+		"game.windowSize", "odd and on range 3 - 63");
+	check(brain.numHiddenLayers >= 1, "brain.numHiddenLayers", "at least 1");
+	check(brain.hiddenLayerSize >= 1, "brain.hiddenLayerSize", "at least 1");
+	check(brain.decisionCacheSize >= 0, "brain.decisionCacheSize", "0 or more");
+	check(brain.blockedMinLayerSize >= 0, "brain.blockedMinLayerSize", "0 or more");
+	// The genetic algorithm picks two different parents
+	check(evolution.numSnakeBrains >= 2, "evolution.numSnakeBrains", "at least 2");
+	check(evolution.partOfParentsUsedForCrossover > 0.0f && evolution.partOfParentsUsedForCrossover <= 1.0f, "evolution.partOfParentsUsedForCrossover", "on range 0 - 1, above 0");
+	check(evolution.mutationProbability >= 0.0f && evolution.mutationProbability <= 1.0f, "evolution.mutationProbability", "on range 0 - 1");
+	check(evolution.numGenerations >= 1, "evolution.numGenerations", "at least 1");
+	check(evolution.reevaluateEvery >= 0, "evolution.reevaluateEvery", "0 or more");
+	check(evolutionStrategy.populationSize >= 2, "evolutionStrategy.populationSize", "at least 2");
+	check(evolutionStrategy.sigma > 0.0f, "evolutionStrategy.sigma", "above 0");
+	check(evaluation.rungKeepFraction > 0.0f && evaluation.rungKeepFraction <= 1.0f, "evaluation.rungKeepFraction", "on range 0 - 1, above 0");
+	check(evaluation.rungSteps.size() == evaluation.rungEpisodes.size(), "evaluation.rungEpisodes", "as many as evaluation.rungSteps");
+	for (size_t i = 0; i < evaluation.rungSteps.size(); i++) {
+		check(evaluation.rungSteps[i] >= 1 && (i == 0 || evaluation.rungSteps[i] >= evaluation.rungSteps[i - 1]), "evaluation.rungSteps", "at least 1 and never decreasing");
+	}
+	for (size_t i = 0; i < evaluation.rungEpisodes.size(); i++) {
+		check(evaluation.rungEpisodes[i] >= 1 && (i == 0 || evaluation.rungEpisodes[i] >= evaluation.rungEpisodes[i - 1]), "evaluation.rungEpisodes", "at least 1 and never decreasing");
+	}
+	check(evaluation.sliceSteps >= 0, "evaluation.sliceSteps", "0 or more");
+	check(evolution.mode != EvolutionMode::SteadyState || (evolution.optimizer == OptimizerType::Genetic && !evaluation.successiveHalving && evaluation.sliceSteps == 0 && !evaluation.longestFirst),
+		"evolution.mode", "Generational with evolution.optimizer=EvolutionStrategy, evaluation.successiveHalving, evaluation.sliceSteps or evaluation.longestFirst");
+	check(!population.outOfCore || (evolution.optimizer == OptimizerType::Genetic && evolution.mode == EvolutionMode::Generational && !evaluation.successiveHalving),
+		"population.outOfCore", "false with evolution.optimizer=EvolutionStrategy, evolution.mode=SteadyState or evaluation.successiveHalving");
+	// Only GeneticOptimizer prunes its elite
+	check(!pruning.elites || (evolution.optimizer == OptimizerType::Genetic && evolution.mode == EvolutionMode::Generational && !population.outOfCore),
+		"pruning.elites", "false with evolution.optimizer=EvolutionStrategy, evolution.mode=SteadyState or population.outOfCore");
+	check(population.memoryBudgetMB >= 1, "population.memoryBudgetMB", "at least 1");
+	check(record.everyNthGame >= 1, "record.everyNthGame", "at least 1");
+	check(record.batchRows >= 1, "record.batchRows", "at least 1");
+	check(pruning.numProbeGames >= 1, "pruning.numProbeGames", "at least 1");
+	check(pruning.weightThreshold >= 0.0f, "pruning.weightThreshold", "0 or more");
+	// 0 is one thread per hardware thread
+	check(threads.numThreads >= 0, "threads.numThreads", "0 or more");
+	check(threads.arenaBytes >= 1, "threads.arenaBytes", "at least 1");
+	check(trace.stepSampleEvery >= 1, "trace.stepSampleEvery", "at least 1");
+
+	return ok;
+}
+
+int SnakeConfiguration::numInputs() const {
+	switch (game.sensor) {
+	case SensorType::Window: return WindowSensor::numInputsFor(game.windowSize);
+	default: return RaySensor::numMeasurements;
+	}
+}
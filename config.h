@@ -1,33 +1,156 @@
 #pragma once
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
+enum class OptimizerType {
+	Genetic,
+	EvolutionStrategy
+};
+
+enum class ThreadAffinity {
+	None,
+	// Worker i runs on logical processor i, taking one per physical core before using hyperthreads
+	Core,
+	// Worker i may run on any processor of NUMA node i % number of nodes
+	NumaNode
+};
+
+enum class SensorType {
+	// Distance to the wall, food and body in eight directions, see RaySensor
+	Rays,
+	// The squares around the head, see WindowSensor
+	Window
+};
+
+enum class EvolutionMode {
+	Generational,
+	// No generations: as soon as a brain is evaluated it competes for a place in the population, and a new child
+	//	is bred from the current best brains. Every game is played in one go, so validate() rejects it together with
+	//	OptimizerType::EvolutionStrategy, successive halving, sliced games and longestFirst
+	SteadyState
+};
+
+// All settings can be changed at runtime, from a file or the command line, with keys like "evolution.mutationProbability".
+//	See set() for the format of the values
 struct SnakeConfiguration {
 	struct Game {
-		static const int numSquares = 20;
-		static const int timeUnitScore = 1;
-		static const int foodScore = 1500;
-		static const int foodTimeAdd = 100;
-		static const bool manualPlay = false;
-		static const int roundTime = 150;
-	};
+		int numSquares = 20;
+		int timeUnitScore = 1;
+		int foodScore = 1500;
+		int foodTimeAdd = 100;
+		bool manualPlay = false;
+		int roundTime = 150;
+		int trainingRoundTime = 300;	// Round time during evolution. Keep it pretty high so the snake can learn!
+		bool incrementalSensing = true;	// Update the ray measurements from the last step instead of measuring from scratch
+		SensorType sensor = SensorType::Rays;
+		int windowSize = 7;	// Squares along each side of the window of SensorType::Window. Odd, 3 - 63
+	} game;
+	// Only used by the application window, so these stay fixed
 	struct Graphics {
 		static const int windowWidth = 1000;
 		static const int windowHeight = 800;
 		static const int boardMarginLeft = 150;
 		static const int boardMarginTop = 50;
 		static const int boardMarginBottom = 50;
-		static const int squareSize = std::min((SnakeConfiguration::Graphics::windowWidth - boardMarginLeft) / Game::numSquares, (SnakeConfiguration::Graphics::windowHeight - boardMarginTop - boardMarginBottom) / Game::numSquares);
 		static constexpr float freezeTimeMs = 2000.0f;
+
+		static int squareSize(int numSquares) {
+			return std::min((windowWidth - boardMarginLeft) / numSquares, (windowHeight - boardMarginTop - boardMarginBottom) / numSquares);
+		}
 	};
 	struct Brain {
-		static const int numHiddenLayers = 2;
-		static const int hiddenLayerSize = 20;
-		static const int outputLayerSize = 3;
-		static const int numInputs = 24;	// Make sure it corresponds with measure()
-	};
+		int numHiddenLayers = 2;
+		int hiddenLayerSize = 20;
+		int outputLayerSize = 3;
+		int decisionCacheSize = 0;	// Decisions each brain remembers for sensor states it has seen before, 16 bytes each. 0 to always think
+		int blockedMinLayerSize = 64;	// Brains with hidden layers at least this wide think with BlockedBrain. 0 to never
+	} brain;
 	struct Evolution {
-		static const int numSnakeBrains = 1500;
-		static constexpr float partOfParentsUsedForCrossover = 0.04f; // On range 0 (none) to 1 (all)
-		static constexpr float mutationProbability = 0.01f;	// On range 0 - 1
-		static const int numGenerations = 50;
-	};
-};
\ No newline at end of file
+		int numSnakeBrains = 1500;
+		float partOfParentsUsedForCrossover = 0.04f; // On range 0 (none) to 1 (all)
+		float mutationProbability = 0.01f;	// On range 0 - 1
+		int numGenerations = 50;
+		OptimizerType optimizer = OptimizerType::Genetic;
+		EvolutionMode mode = EvolutionMode::Generational;
+		// SteadyState: every reevaluateEvery:th evaluation plays another game with one of the parents instead of a
+		//	new child, so the fitness of the parents is averaged over several games. 0 to never
+		int reevaluateEvery = 5;
+		int targetFitness = 0;	// Stop as soon as a brain reaches this fitness. 0 to always run all generations
+		std::string brainOutputPath = "snake_brain.bin";	// Best brain is saved here, for use with the inference library
+		bool printProgress = true;	// Print a line per generation
+	} evolution;
+	// Successive halving: all brains first play with a short step budget, and only the best part of them
+	//	go on to longer games and more episodes. Games are resumed, not restarted, when moving up a rung
+	struct Evaluation {
+		bool successiveHalving = false;
+		std::vector<int> rungSteps = { 100, 1000, 50000 };	// Max steps per game in each rung
+		std::vector<int> rungEpisodes = { 1, 1, 2 };	// Games per brain in each rung. Should never decrease
+		float rungKeepFraction = 0.25f;	// Part of the brains that is promoted to the next rung
+		bool longestFirst = false;	// Start the games expected to be longest first, see SnakeBrain::expectedSteps
+		// Steps a game plays at a time. Each round plays one slice of every game that isn't over, one task per slice,
+		//	so a long game doesn't hold a worker while the other runs of a sweep wait. 0 plays each game in one go.
+		//	Not used with successive halving
+		int sliceSteps = 0;
+	} evaluation;
+	// Keeps the population in memory mapped files instead of in memory, for populations too large for RAM.
+	//	Only works with OptimizerType::Genetic in generational mode, and without successive halving; validate()
+	//	rejects the other combinations
+	struct Population {
+		bool outOfCore = false;
+		// Each generation is bred from one file into the other
+		std::string path1 = "population_1.bin";
+		std::string path2 = "population_2.bin";
+		// Genomes kept in memory at once: half for the shard being evaluated or bred, half for the parents.
+		//	On top of this, the fitness of every brain and, while the parents are picked, its rank are kept in
+		//	memory: 8 bytes per brain
+		int memoryBudgetMB = 256;
+	} population;
+	// Streams every step of some of the games played during evolution to a file, for analysis. See trajectory_file.h
+	struct Record {
+		bool enabled = false;
+		int everyNthGame = 1000;	// Records game 0, n, 2n etc
+		int batchRows = 4096;	// Steps per batch in the file
+		std::string outputPath = "clsnake_trajectories.bin";
+	} record;
+	// Drops small weights and neurons that never fire, and compiles the brain to a sparse form that thinks faster.
+	//	See pruning.h
+	struct Pruning {
+		bool afterTraining = false;	// Prune the best brain after evolution and print how fitness and speed changed
+		bool elites = false;	// Prune the elite of every generation, so the population evolves pruned brains. Generational genetic optimizer in memory only, see validate()
+		float weightThreshold = 0.2f;	// Weights closer to 0 than this are dropped
+		int numProbeGames = 20;	// Games played to find the neurons that never fire, and to compare fitness
+	} pruning;
+	// Evaluation threads
+	struct Threads {
+		int numThreads = 0;	// 0 for one per hardware thread
+		ThreadAffinity affinity = ThreadAffinity::None;
+		int arenaBytes = 1 << 16;	// Per thread memory for one game. Reset after each game
+	} threads;
+	// Only used when built with CLSNAKE_TRACE=1, see trace.h
+	struct Trace {
+		int stepSampleEvery = 64;	// Record every n:th step of a game on each thread
+		std::string outputPath = "clsnake_trace.json";
+	} trace;
+	// Used when optimizer is OptimizerType::EvolutionStrategy
+	struct EvolutionStrategy {
+		int populationSize = 100;	// Candidates come in mirrored pairs, so keep it even
+		float sigma = 0.3f;	// Standard deviation of the weight perturbations
+		float learningRate = 0.1f;
+	} evolutionStrategy;
+
+	// Sets one value, eg. set("evolution.optimizer", "EvolutionStrategy"). Lists are comma separated,
+	//	booleans are true/false and enums use the names of their values. Prints a message and returns false on
+	//	unknown keys or bad values
+	bool set(const std::string& key, const std::string& value);
+	// Applies a file with one "key = value" per line. Empty lines and lines starting with # are skipped
+	bool loadFile(const std::string& path);
+	// Applies settings like "key=value" or "key = value", separated by whitespace
+	bool apply(const std::string& settings);
+	// Checks that the values make sense together, eg. that there are enough brains to pick two parents. Prints a
+	//	message naming the key for each problem. Call after all values are set
+	bool validate() const;
+	// Number of brain inputs, given by game.sensor
+	int numInputs() const;
+};
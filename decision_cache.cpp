@@ -0,0 +1,89 @@
+#include <bit>
+#include <algorithm>
+
+#include "decision_cache.h"
+
+DecisionCache::DecisionCache(int tCapacity) {
+	numEntries = static_cast<int>(std::bit_ceil(static_cast<unsigned int>(std::max(2, tCapacity))));
+	shift = 64 - std::countr_zero(static_cast<unsigned int>(numEntries));
+}
+
+int DecisionCache::capacity() {
+	return numEntries;
+}
+
+int DecisionCache::slot(uint64_t key) {
+	// Fibonacci hashing; the low bits of the key are the same for most states, so we use the high bits of the product
+	return static_cast<int>((key * 0x9E3779B97F4A7C15ull) >> shift);
+}
+
+DecisionCache::Counters& DecisionCache::threadCounters() {
+	static std::atomic<int> nextStripe = 0;
+	thread_local int stripe = nextStripe++ % numCounterStripes;
+
+	return counters[stripe];
+}
+
+bool DecisionCache::find(uint64_t key, SnakeMove& move) {
+	Entry* table = entries.load(std::memory_order_acquire);
+
+	if (table != nullptr) {
+		Entry& entry = table[slot(key)];
+		uint32_t before = entry.sequence.load(std::memory_order_acquire);
+		uint64_t storedKey = entry.key.load(std::memory_order_relaxed);
+		uint8_t storedMove = entry.move.load(std::memory_order_relaxed);
+		// Keeps the reads above before the second read of the sequence
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint32_t after = entry.sequence.load(std::memory_order_relaxed);
+
+		if (before % 2 == 0 && before == after && storedMove != 0 && storedKey == key) {
+			move = static_cast<SnakeMove>(storedMove - 1);
+			threadCounters().hits.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	threadCounters().misses.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+void DecisionCache::insert(uint64_t key, SnakeMove move) {
+	Entry* table = entries.load(std::memory_order_acquire);
+
+	if (table == nullptr) {
+		std::lock_guard<std::mutex> lock(allocateMutex);
+		if (storage == nullptr) {
+			storage = std::make_unique<Entry[]>(numEntries);
+			entries.store(storage.get(), std::memory_order_release);
+		}
+		table = storage.get();
+	}
+
+	Entry& entry = table[slot(key)];
+	uint32_t sequence = entry.sequence.load(std::memory_order_relaxed);
+	if (sequence % 2 != 0 || !entry.sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_relaxed)) {
+		return;
+	}
+	// Readers that see the new key or move also see the odd sequence
+	std::atomic_thread_fence(std::memory_order_release);
+	entry.key.store(key, std::memory_order_relaxed);
+	entry.move.store(static_cast<uint8_t>(static_cast<int>(move) + 1), std::memory_order_relaxed);
+	entry.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void DecisionCache::clear() {
+	std::lock_guard<std::mutex> lock(allocateMutex);
+
+	entries.store(nullptr, std::memory_order_release);
+	storage = nullptr;
+}
+
+void DecisionCache::takeStats(long long& hits, long long& misses) {
+	hits = 0;
+	misses = 0;
+
+	for (auto& c : counters) {
+		hits += c.hits.exchange(0, std::memory_order_relaxed);
+		misses += c.misses.exchange(0, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <atomic>
+#include <mutex>
+
+#include "snake.h"
+
+// Remembers the move a brain made for a sensor state, encoded by encodeMeasurements() in sensor.h, so a brain that
+//	sees the same state again doesn't have to think. The number of entries is fixed; a new state replaces whatever
+//	was stored in its slot. Several games can use the same cache at once without locking: each entry is a small
+//	seqlock, so a lookup that races with a write to the same entry is just a miss
+class DecisionCache {
+public:
+	// Rounded up to a power of two. Memory is only allocated once something is stored
+	DecisionCache(int tCapacity);
+
+	int capacity();
+	// Returns false if the state isn't stored
+	bool find(uint64_t key, SnakeMove& move);
+	// Skipped if another thread is writing the same entry
+	void insert(uint64_t key, SnakeMove move);
+	// Not while the cache is used by a game
+	void clear();
+	// Hits and misses since the last call
+	void takeStats(long long& hits, long long& misses);
+private:
+	struct Entry {
+		// Odd while the entry is written
+		std::atomic<uint32_t> sequence;
+		// The move plus one, 0 when unused
+		std::atomic<uint8_t> move;
+		std::atomic<uint64_t> key;
+	};
+
+	// Each thread counts in one of these, so the threads don't fight over the cache line of a shared counter
+	struct alignas(64) Counters {
+		std::atomic<long long> hits = 0;
+		std::atomic<long long> misses = 0;
+	};
+	static const int numCounterStripes = 16;
+
+	int numEntries;
+	int shift;
+	std::unique_ptr<Entry[]> storage;
+	// Published once storage is allocated
+	std::atomic<Entry*> entries = nullptr;
+	std::mutex allocateMutex;
+	Counters counters[numCounterStripes];
+
+	int slot(uint64_t key);
+	Counters& threadCounters();
+};
@@ -0,0 +1,270 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <numeric>
+#include <algorithm>
+
+#include "evaluation.h"
+#include "config.h"
+#include "game.h"
+#include "trace.h"
+#include "decision_cache.h"
+#include "blocked_brain.h"
+
+namespace ClSnake {
+
+	void EvaluationStats::add(const EvaluationStats& other) {
+		numGames += other.numGames;
+		numSteps += other.numSteps;
+		numGamesCutShort += other.numGamesCutShort;
+		numStepsSaved += other.numStepsSaved;
+		numCacheHits += other.numCacheHits;
+		numCacheMisses += other.numCacheMisses;
+		workerBusyNs += other.workerBusyNs;
+		workerAvailableNs += other.workerAvailableNs;
+	}
+
+	void prepareDecisionCaches(const SnakeConfiguration& config, std::vector<SnakeBrain>& brains) {
+		for (auto& brain : brains) {
+			brain.setDecisionCache(config.brain.decisionCacheSize);
+		}
+	}
+
+	bool usesBlockedBrains(const SnakeConfiguration& config) {
+		return config.brain.blockedMinLayerSize > 0 && config.brain.hiddenLayerSize >= config.brain.blockedMinLayerSize;
+	}
+
+	void prepareBlockedBrain(const SnakeConfiguration& config, SnakeBrain& brain) {
+		if (usesBlockedBrains(config) && brain.blockedBrain() == nullptr && brain.sparseBrain() == nullptr) {
+			brain.compileBlocked();
+		}
+	}
+
+	void prepareBlockedBrains(const SnakeConfiguration& config, WorkerPool& pool, std::vector<SnakeBrain>& brains) {
+		if (usesBlockedBrains(config)) {
+			pool.parallelFor(static_cast<int>(brains.size()), [&config, &brains](int idxBrain) {
+				prepareBlockedBrain(config, brains[idxBrain]);
+				});
+		}
+	}
+
+	void collectDecisionCacheStats(SnakeBrain& brain, EvaluationStats& stats) {
+		if (brain.decisionCache() != nullptr) {
+			long long hits = 0;
+			long long misses = 0;
+			brain.decisionCache()->takeStats(hits, misses);
+			stats.numCacheHits += hits;
+			stats.numCacheMisses += misses;
+		}
+	}
+
+	void selectForRecording(TrajectoryRecorder* recorder, Game& game) {
+		uint32_t gameNumber = 0;
+
+		if (recorder != nullptr && recorder->selectGame(gameNumber)) {
+			game.record(recorder, gameNumber);
+		}
+	}
+
+	// Puts the brains in indices in the order their games should start. With longestFirst, the longest expected games
+	//	come first, so they don't start last and keep the generation waiting while the other workers are idle
+	void sortLongestFirst(const SnakeConfiguration& config, const std::vector<SnakeBrain>& brains, std::vector<int>& indices) {
+		if (config.evaluation.longestFirst) {
+			std::stable_sort(indices.begin(), indices.end(), [&brains](int a, int b) {return brains[a].expectedSteps > brains[b].expectedSteps; });
+		}
+	}
+
+	int expectedSteps(const SnakeConfiguration& config, const SnakeBrain& brain) {
+		return config.evaluation.longestFirst ? brain.expectedSteps : 0;
+	}
+
+	long long nanosecondsSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Games are played sliceSteps at a time, in rounds: each round plays one slice of every game that isn't over,
+	//	one task per slice, so other jobs on the pool (eg. the other runs of a sweep) get their turn between slices.
+	//	With longestFirst, the games expected to have the most steps left go first in each round
+	void evaluatePopulationSliced(const SnakeConfiguration& config, WorkerPool& pool, std::vector<SnakeBrain>& brains, std::vector<int>& fitness, EvaluationStats& stats, TrajectoryRecorder* recorder) {
+		const int numBrains = static_cast<int>(brains.size());
+		const int sliceSteps = config.evaluation.sliceSteps;
+
+		// Games move between workers, so they can't use the worker arenas
+		std::vector<std::unique_ptr<Game>> games(numBrains);
+		// A game that has played more than expected is guessed to last as long again, since the snakes that survive
+		//	for long tend to keep going
+		std::vector<int> stepsLeft(numBrains);
+		std::vector<int> running(numBrains);
+		std::iota(running.begin(), running.end(), 0);
+		std::atomic<long long> numSteps = 0;
+		std::atomic<long long> busyNs = 0;
+
+		for (int idxBrain = 0; idxBrain < numBrains; idxBrain++) {
+			stepsLeft[idxBrain] = expectedSteps(config, brains[idxBrain]);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		while (!running.empty()) {
+			if (config.evaluation.longestFirst) {
+				std::stable_sort(running.begin(), running.end(), [&stepsLeft](int a, int b) {return stepsLeft[a] > stepsLeft[b]; });
+			}
+
+			pool.parallelFor(static_cast<int>(running.size()), [&](int idxTask) {
+				auto busyStart = std::chrono::steady_clock::now();
+				int idxBrain = running[idxTask];
+				auto& game = games[idxBrain];
+				if (game == nullptr) {
+					game = std::make_unique<Game>(config, &brains[idxBrain], config.game.numSquares, config.game.numSquares, config.game.trainingRoundTime);
+					selectForRecording(recorder, *game);
+				}
+				int stepsBefore = game->stepsPlayed();
+				game->playSteps(sliceSteps);
+				int stepsPlayed = game->stepsPlayed();
+				numSteps += stepsPlayed - stepsBefore;
+				stepsLeft[idxBrain] = std::max(expectedSteps(config, brains[idxBrain]) - stepsPlayed, stepsPlayed);
+				busyNs += nanosecondsSince(busyStart);
+				});
+
+			std::erase_if(running, [&](int idxBrain) {
+				auto& game = games[idxBrain];
+				if (!game->isOver()) {
+					return false;
+				}
+				fitness[idxBrain] = game->fitness();
+				brains[idxBrain].expectedSteps = game->stepsPlayed();
+				game = nullptr;
+				return true;
+				});
+		}
+
+		stats.numGames += numBrains;
+		stats.numSteps += numSteps;
+		stats.workerBusyNs += busyNs;
+		stats.workerAvailableNs += nanosecondsSince(start) * pool.size();
+	}
+
+	void evaluatePopulationFull(const SnakeConfiguration& config, WorkerPool& pool, std::vector<SnakeBrain>& brains, std::vector<int>& fitness, EvaluationStats& stats, TrajectoryRecorder* recorder) {
+		std::vector<int> order(brains.size());
+		std::iota(order.begin(), order.end(), 0);
+		sortLongestFirst(config, brains, order);
+		std::atomic<long long> numSteps = 0;
+		std::atomic<long long> busyNs = 0;
+
+		auto start = std::chrono::steady_clock::now();
+		pool.parallelFor(static_cast<int>(brains.size()), [&config, &brains, &fitness, &order, &numSteps, &busyNs, recorder](int idx) {
+			auto busyStart = std::chrono::steady_clock::now();
+			int idxBrain = order[idx];
+			Arena* arena = WorkerPool::currentArena();
+			{
+				Game game(config, &brains[idxBrain], config.game.numSquares, config.game.numSquares, config.game.trainingRoundTime, arena->resource());
+				selectForRecording(recorder, game);
+				game.play();
+				fitness[idxBrain] = game.fitness();
+				brains[idxBrain].expectedSteps = game.stepsPlayed();
+				numSteps += game.stepsPlayed();
+			}
+			arena->reset();
+			busyNs += nanosecondsSince(busyStart);
+			});
+
+		stats.numGames += brains.size();
+		stats.numSteps += numSteps;
+		stats.workerBusyNs += busyNs;
+		stats.workerAvailableNs += nanosecondsSince(start) * pool.size();
+	}
+
+	void evaluatePopulationSuccessiveHalving(const SnakeConfiguration& config, WorkerPool& pool, std::vector<SnakeBrain>& brains, std::vector<int>& fitness, EvaluationStats& stats, TrajectoryRecorder* recorder) {
+		const int numRungs = static_cast<int>(std::min(config.evaluation.rungSteps.size(), config.evaluation.rungEpisodes.size()));
+		const int maxEpisodes = *std::max_element(config.evaluation.rungEpisodes.begin(), config.evaluation.rungEpisodes.begin() + numRungs);
+		const int numBrains = static_cast<int>(brains.size());
+
+		// Games are kept between rungs, so promoted brains continue where they left off. Since they move between
+		//	workers, they can't use the worker arenas
+		std::vector<std::unique_ptr<Game>> games(numBrains * maxEpisodes);
+		std::atomic<long long> numSteps = 0;
+		std::atomic<long long> numGames = 0;
+
+		std::vector<int> survivors(numBrains);
+		std::iota(survivors.begin(), survivors.end(), 0);
+
+		for (int rung = 0; rung < numRungs; rung++) {
+			TRACE_SCOPE("successive halving rung");
+			const int rungSteps = config.evaluation.rungSteps[rung];
+			const int numEpisodes = config.evaluation.rungEpisodes[rung];
+
+			std::vector<int> order = survivors;
+			sortLongestFirst(config, brains, order);
+
+			pool.parallelFor(static_cast<int>(order.size()) * numEpisodes, [&](int idxTask) {
+				int idxBrain = order[idxTask / numEpisodes];
+				auto& game = games[idxBrain * maxEpisodes + idxTask % numEpisodes];
+				if (game == nullptr) {
+					game = std::make_unique<Game>(config, &brains[idxBrain], config.game.numSquares, config.game.numSquares, config.game.trainingRoundTime);
+					selectForRecording(recorder, *game);
+					numGames++;
+				}
+				int stepsBefore = game->stepsPlayed();
+				game->playSteps(rungSteps - stepsBefore);
+				numSteps += game->stepsPlayed() - stepsBefore;
+				});
+
+			// Fitness is the mean over the episodes played so far. For a game that was cut short it's a lower bound
+			for (auto idxBrain : survivors) {
+				long long sum = 0;
+				for (int episode = 0; episode < numEpisodes; episode++) {
+					sum += games[idxBrain * maxEpisodes + episode]->fitness();
+				}
+				fitness[idxBrain] = static_cast<int>(sum / numEpisodes);
+			}
+
+			if (rung == numRungs - 1) {
+				break;
+			}
+
+			std::stable_sort(survivors.begin(), survivors.end(), [&fitness](int a, int b) {return fitness[a] > fitness[b]; });
+			int numKeep = std::max(1, static_cast<int>(survivors.size() * config.evaluation.rungKeepFraction));
+
+			// Brains that are dropped here never play their remaining steps. Most of them just circle until
+			//	the round time is up, so the time left of their games is a fair estimate of what we saved
+			for (int i = numKeep; i < survivors.size(); i++) {
+				for (int episode = 0; episode < numEpisodes; episode++) {
+					auto& game = games[survivors[i] * maxEpisodes + episode];
+					if (!game->isOver()) {
+						stats.numGamesCutShort++;
+						stats.numStepsSaved += game->timeLeft;
+					}
+				}
+			}
+
+			survivors.resize(numKeep);
+		}
+
+		// Lower bounds for the games that were cut short, but those brains are rarely picked as parents
+		for (int idxBrain = 0; idxBrain < numBrains; idxBrain++) {
+			brains[idxBrain].expectedSteps = games[idxBrain * maxEpisodes]->stepsPlayed();
+		}
+
+		stats.numGames += numGames;
+		stats.numSteps += numSteps;
+	}
+
+	void evaluatePopulation(const SnakeConfiguration& config, WorkerPool& pool, std::vector<SnakeBrain>& brains, std::vector<int>& fitness, EvaluationStats& stats, TrajectoryRecorder* recorder) {
+		fitness.assign(brains.size(), 0);
+		prepareDecisionCaches(config, brains);
+		prepareBlockedBrains(config, pool, brains);
+
+		if (config.evaluation.successiveHalving) {
+			evaluatePopulationSuccessiveHalving(config, pool, brains, fitness, stats, recorder);
+		}
+		else if (config.evaluation.sliceSteps > 0) {
+			evaluatePopulationSliced(config, pool, brains, fitness, stats, recorder);
+		}
+		else {
+			evaluatePopulationFull(config, pool, brains, fitness, stats, recorder);
+		}
+
+		for (auto& brain : brains) {
+			collectDecisionCacheStats(brain, stats);
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+
+#include "snake.h"
+#include "config.h"
+#include "game.h"
+#include "worker_pool.h"
+#include "trajectory_recorder.h"
+
+namespace ClSnake {
+
+	struct EvaluationStats {
+		long long numGames = 0;
+		long long numSteps = 0;
+		// Only used with successive halving
+		long long numGamesCutShort = 0;
+		long long numStepsSaved = 0;
+		// Only used with a decision cache
+		long long numCacheHits = 0;
+		long long numCacheMisses = 0;
+		// Time the workers spent playing, and the time they were available: the evaluation time times the workers
+		long long workerBusyNs = 0;
+		long long workerAvailableNs = 0;
+
+		void add(const EvaluationStats& other);
+	};
+
+	// Turns on the decision cache of each brain if config asks for it. Brains that already have one keep it
+	void prepareDecisionCaches(const SnakeConfiguration& config, std::vector<SnakeBrain>& brains);
+	// Compiles brain to a BlockedBrain if its hidden layers are wide enough, see SnakeConfiguration::Brain
+	void prepareBlockedBrain(const SnakeConfiguration& config, SnakeBrain& brain);
+	// Same for all brains, spread over the pool
+	void prepareBlockedBrains(const SnakeConfiguration& config, WorkerPool& pool, std::vector<SnakeBrain>& brains);
+	// Adds the cache hits and misses of brain since the last call to stats
+	void collectDecisionCacheStats(SnakeBrain& brain, EvaluationStats& stats);
+
+	// Plays one game per brain, spread over the pool, and stores the fitness of brains[i] in fitness[i].
+	//	With successive halving, see SnakeConfiguration::Evaluation, only the best brains play full games
+	//	Games selected by recorder, if any, are recorded. With evaluation.longestFirst the longest expected games
+	//	start first, and with evaluation.sliceSteps they are played a slice at a time. Stores the steps played in
+	//	SnakeBrain::expectedSteps
+	void evaluatePopulation(const SnakeConfiguration& config, WorkerPool& pool, std::vector<SnakeBrain>& brains, std::vector<int>& fitness, EvaluationStats& stats, TrajectoryRecorder* recorder = nullptr);
+	// Call for each new game. Makes the game record its steps if recorder selects it
+	void selectForRecording(TrajectoryRecorder* recorder, Game& game);
+}
@@ -1,126 +1,493 @@
 #include <format>
-#include <thread>
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <numeric>
+#include <functional>
 #include <SDL2/SDL_timer.h>
 
 #include "evolution.h"
 #include "config.h"
 #include "game.h"
+#include "evaluation.h"
+#include "optimizer.h"
+#include "worker_pool.h"
+#include "ranked_population.h"
+#include "genome_store.h"
+#include "trajectory_recorder.h"
+#include "trace.h"
 
 namespace ClSnake {
 
 	SnakeBrain crossOver(SnakeBrain* parent1, SnakeBrain* parent2) {
-		std::vector<SnakePerceptron> perceptrons;
+		std::vector<std::shared_ptr<const SnakePerceptron>> perceptrons;
+		perceptrons.reserve(parent1->perceptrons.size());
 
+		// The child shares the perceptrons with its parents; nothing is copied until it is mutated
 		for (int i = 0; i < parent1->perceptrons.size(); i++) {
 			SnakeBrain* useBrain = (getRandomInt(0, 1000) > 500) ? parent1 : parent2;
-			perceptrons.push_back(useBrain->perceptrons[i].clone());
+			perceptrons.push_back(useBrain->perceptrons[i]);
 		}
 
-		return SnakeBrain(perceptrons, parent1->numInputs, parent1->numHiddenLayers, parent1->hiddenLayerSize, parent1->outputLayerSize);
+		SnakeBrain child(std::move(perceptrons), parent1->numInputs, parent1->numHiddenLayers, parent1->hiddenLayerSize, parent1->outputLayerSize);
+		child.expectedSteps = (parent1->expectedSteps + parent2->expectedSteps) / 2;
+
+		return child;
 	}
 
 	// Probability for mutation, on range 0 - 1
 	void mutate(SnakeBrain* brain, float probability) {
+		bool changed = false;
+		auto writable = [brain, &changed](int idxPerceptron) {
+			if (!changed) {
+				brain->weightsChanged();
+				changed = true;
+			}
+			return brain->mutablePerceptron(idxPerceptron);
+		};
 
-		for (auto& p : brain->perceptrons) {
-			for (int i = 0; i < p.w.size(); i++) {
+		for (int idxPerceptron = 0; idxPerceptron < brain->perceptrons.size(); idxPerceptron++) {
+			// Only copy the perceptron if something in it actually changes
+			SnakePerceptron* p = nullptr;
+			const int numWeights = static_cast<int>(brain->perceptrons[idxPerceptron]->w.size());
+			for (int i = 0; i < numWeights; i++) {
 				if (getRandomFloat(0.0f, 1.0f) < probability) {
-					p.w[i] = getRandomFloat(-1.0f, 1.0f);
+					if (p == nullptr) {
+						p = writable(idxPerceptron);
+					}
+					p->w[i] = getRandomFloat(-1.0f, 1.0f);
 				}
 			}
 			if (getRandomFloat(0.0f, 1.0f) < probability) {
-				p.b = getRandomFloat(-1.0f, 1.0f);
+				if (p == nullptr) {
+					p = writable(idxPerceptron);
+				}
+				p->b = getRandomFloat(-1.0f, 1.0f);
 			}
 		}
 	}
 
 	SnakeBrain makeChild(SnakeBrain* parent1, SnakeBrain* parent2, float mutationProbability) {
+		TRACE_SCOPE("makeChild");
 		auto child = crossOver(parent1, parent2);
 		mutate(&child, mutationProbability);
 
 		return child;
 	}
 
-	void evolve(std::vector<SnakeBrain>& replaySnakeBrains, int& useSnakeBrainGeneration) {
-		std::vector<SnakeBrain> snakeBrains;
-
-		for (int i = 0; i < SnakeConfiguration::Evolution::numSnakeBrains; i++) {
-			SnakeBrain brain(SnakeConfiguration::Brain::numInputs, SnakeConfiguration::Brain::numHiddenLayers, SnakeConfiguration::Brain::hiddenLayerSize, SnakeConfiguration::Brain::outputLayerSize);
-			snakeBrains.push_back(brain);
+	void printDecisionCacheStats(const EvaluationStats& stats) {
+		long long numLookups = stats.numCacheHits + stats.numCacheMisses;
+		if (numLookups > 0) {
+			std::cout << std::format("Decision cache: {} hits, {} misses ({}% hits)", stats.numCacheHits, stats.numCacheMisses, 100 * stats.numCacheHits / numLookups) << std::endl;
 		}
+	}
 
-		// hardware_concurrency will return 0 when not able to detect
-		const int numThreads = std::max(1u, std::thread::hardware_concurrency());
-
-		std::cout << std::format("Running evolution with {} threads\n-----\n", numThreads);
+	EvolutionResult evolveGenerational(const SnakeConfiguration& config, WorkerPool& pool, std::vector<SnakeBrain>& replaySnakeBrains, int& useSnakeBrainGeneration, TrajectoryRecorder* recorder) {
+		auto optimizer = makeOptimizer(config);
+		const bool print = config.evolution.printProgress;
 
-		std::cout << std::format("Gen\tMax score\tTime (s)") << std::endl;
+		if (print) {
+			std::cout << std::format("Running evolution ({}) with {} threads\n-----\n", optimizer->name(), pool.size());
+			std::cout << std::format("Gen\tMax score\tTime (s)") << std::endl;
+		}
 		auto bestGenerationScore = 0;
+		EvaluationStats stats;
+		std::vector<int> fitness;
 
-		for (int gen = 0; gen < SnakeConfiguration::Evolution::numGenerations; gen++) {
+		for (int gen = 0; gen < config.evolution.numGenerations; gen++) {
 			auto genStartTime = SDL_GetTicks64();
-			std::vector<std::tuple<int, SnakeBrain*>> brainsWithScore(snakeBrains.size(), std::tuple<int, SnakeBrain*>(0, 0));
+			auto& snakeBrains = optimizer->population();
 
 			// Start with evaluation the fitness of each chromosome in the current generation
-			for (int brainOffset = 0; brainOffset < snakeBrains.size(); brainOffset += numThreads) {
-				std::vector<std::thread> threads;
-				for (int idxBrain = brainOffset; idxBrain < std::min(SnakeConfiguration::Evolution::numSnakeBrains, brainOffset + numThreads); idxBrain++) {
-					SnakeBrain& brain = snakeBrains[idxBrain];
-					threads.push_back(std::thread([&brainsWithScore, &brain, idxBrain]() {
-						Game game(&brain, SnakeConfiguration::Game::numSquares, SnakeConfiguration::Game::numSquares);
-						game.play();
-						auto fitness = game.fitness();
-						brainsWithScore[idxBrain] = std::tuple<int, SnakeBrain*>(fitness, &brain);
-						}));
+			EvaluationStats genStats;
+			{
+				TRACE_SCOPE("evaluatePopulation");
+				evaluatePopulation(config, pool, snakeBrains, fitness, genStats, recorder);
+			}
+			stats.add(genStats);
 
+			auto idxBest = std::distance(fitness.begin(), std::max_element(fitness.begin(), fitness.end()));
+			auto maxScore = fitness[idxBest];
+			auto genTimeS = (SDL_GetTicks64() - genStartTime) / 1000.0f;
+			if (print) {
+				std::cout << std::format("{}\t{}\t\t{}", gen + 1, maxScore, genTimeS) << std::endl;
+				if (config.evaluation.successiveHalving) {
+					std::cout << std::format("\t{} steps played, {} games cut short, ~{} steps saved", genStats.numSteps, genStats.numGamesCutShort, genStats.numStepsSaved) << std::endl;
 				}
-				for (auto& t : threads) {
-					t.join();
+			}
+
+			if (maxScore > bestGenerationScore) {
+				useSnakeBrainGeneration = gen;
+				bestGenerationScore = maxScore;
+			}
+
+			replaySnakeBrains.push_back(snakeBrains[idxBest].clone());
+
+			if (config.evolution.targetFitness > 0 && maxScore >= config.evolution.targetFitness) {
+				if (print) {
+					std::cout << std::format("Reached target fitness {}", config.evolution.targetFitness) << std::endl;
 				}
+				break;
 			}
 
-			std::sort(brainsWithScore.begin(), brainsWithScore.end(), [](std::tuple<int, SnakeBrain*> a, std::tuple<int, SnakeBrain*>b) {return std::get<0>(a) > std::get<0>(b); });
+			// Time to evolve!
+			if (gen < config.evolution.numGenerations - 1) {
+				TRACE_SCOPE("reproduction");
+				optimizer->tell(fitness);
+			}
+		}
+
+		if (print) {
+			std::cout << std::format("Simulated {} games ({} steps)", stats.numGames, stats.numSteps) << std::endl;
+			if (config.evaluation.successiveHalving) {
+				std::cout << std::format("Successive halving cut {} games short, saving ~{} steps", stats.numGamesCutShort, stats.numStepsSaved) << std::endl;
+			}
+			if (stats.workerAvailableNs > 0) {
+				std::cout << std::format("Worker utilization {}%", 100 * stats.workerBusyNs / stats.workerAvailableNs) << std::endl;
+			}
+			printDecisionCacheStats(stats);
+		}
 
-			auto bestBrainInGeneration = std::get<1>(brainsWithScore.front());
+		return { bestGenerationScore, stats.numGames, stats.numSteps };
+	}
 
-			auto maxScore = std::get<0>(brainsWithScore.front());
+	EvolutionResult evolveSteadyState(const SnakeConfiguration& config, WorkerPool& pool, std::vector<SnakeBrain>& replaySnakeBrains, int& useSnakeBrainGeneration, TrajectoryRecorder* recorder) {
+		RankedPopulation population(config.evolution.numSnakeBrains);
+		// Same number of games as in generational mode. A "generation" below is just as many evaluations as the population size
+		const int numEvaluations = config.evolution.numSnakeBrains * config.evolution.numGenerations;
+		const bool print = config.evolution.printProgress;
+
+		if (print) {
+			std::cout << std::format("Running steady-state evolution with {} threads\n-----\n", pool.size());
+			std::cout << std::format("Gen\tMax score\tTime (s)") << std::endl;
+		}
+		auto bestGenerationScore = 0;
+		std::atomic<long long> numFinished = 0;
+		std::atomic<long long> numSteps = 0;
+		std::atomic<long long> workerBusyNs = 0;
+		std::atomic<bool> targetReached = false;
+		std::mutex reportMutex;
+		std::vector<EvaluationStats> workerStats(pool.size());
+		auto startTime = SDL_GetTicks64();
+		auto genStartTime = startTime;
+
+		// Each index is one evaluation: breed from the current population, play, insert (or play another game with a
+		//	parent). No waiting for other workers
+		pool.parallelFor(numEvaluations, [&](int idxEvaluation) {
+			if (targetReached) {
+				return;
+			}
+
+			TRACE_SCOPE("evaluation");
+			auto busyStart = std::chrono::steady_clock::now();
+
+			auto play = [&](SnakeBrain& brain) {
+				Arena* arena = WorkerPool::currentArena();
+				int fitness = 0;
+				{
+					Game game(config, &brain, config.game.numSquares, config.game.numSquares, config.game.trainingRoundTime, arena->resource());
+					selectForRecording(recorder, game);
+					game.play();
+					fitness = game.fitness();
+					numSteps += game.stepsPlayed();
+				}
+				arena->reset();
+				collectDecisionCacheStats(brain, workerStats[WorkerPool::currentWorker()]);
+				return fitness;
+			};
+
+			// A single game is a noisy measure, so the parents play again now and then. Otherwise one lucky game
+			//	keeps a brain at the top for good
+			std::shared_ptr<SnakeBrain> member;
+			const int reevaluateEvery = config.evolution.reevaluateEvery;
+			if (idxEvaluation >= config.evolution.numSnakeBrains && reevaluateEvery > 0 && idxEvaluation % reevaluateEvery == 0
+				&& population.pickForReevaluation(config.evolution.partOfParentsUsedForCrossover, member)) {
+				population.addEvaluation(member, play(*member));
+			}
+			else {
+				std::shared_ptr<SnakeBrain> parent1;
+				std::shared_ptr<SnakeBrain> parent2;
+				// Start with random brains, just as the first generation
+				bool isRandom = idxEvaluation < config.evolution.numSnakeBrains || !population.pickParents(config.evolution.partOfParentsUsedForCrossover, parent1, parent2);
+				SnakeBrain brain = isRandom
+					? SnakeBrain(config.numInputs(), config.brain.numHiddenLayers, config.brain.hiddenLayerSize, config.brain.outputLayerSize)
+					: ClSnake::makeChild(parent1.get(), parent2.get(), config.evolution.mutationProbability);
+				brain.setDecisionCache(config.brain.decisionCacheSize);
+				prepareBlockedBrain(config, brain);
+
+				int fitness = play(brain);
+				population.insert(std::move(brain), fitness);
+			}
+			workerBusyNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - busyStart).count();
+
+			long long numDone = ++numFinished;
+			if (numDone % config.evolution.numSnakeBrains == 0) {
+				std::lock_guard<std::mutex> lock(reportMutex);
+				int maxScore = 0;
+				replaySnakeBrains.push_back(population.best(maxScore));
+				int gen = static_cast<int>(replaySnakeBrains.size()) - 1;
+				auto now = SDL_GetTicks64();
+				if (print) {
+					std::cout << std::format("{}\t{}\t\t{}", gen + 1, maxScore, (now - genStartTime) / 1000.0f) << std::endl;
+				}
+				genStartTime = now;
+
+				if (maxScore > bestGenerationScore) {
+					useSnakeBrainGeneration = gen;
+					bestGenerationScore = maxScore;
+				}
+				if (config.evolution.targetFitness > 0 && maxScore >= config.evolution.targetFitness) {
+					if (print) {
+						std::cout << std::format("Reached target fitness {}", config.evolution.targetFitness) << std::endl;
+					}
+					targetReached = true;
+				}
+			}
+			});
+
+		if (print) {
+			auto totalNs = std::max(1ull, static_cast<unsigned long long>(SDL_GetTicks64() - startTime)) * 1'000'000;
+			std::cout << std::format("Simulated {} games ({} steps)", numFinished.load(), numSteps.load()) << std::endl;
+			std::cout << std::format("Worker utilization {}%", 100 * workerBusyNs / (totalNs * pool.size())) << std::endl;
+			EvaluationStats stats;
+			for (auto& w : workerStats) {
+				stats.add(w);
+			}
+			printDecisionCacheStats(stats);
+		}
+
+		return { bestGenerationScore, numFinished.load(), numSteps.load() };
+	}
+
+	// Runs fn(first, count) for each shard of the store, with the shard mapped
+	bool forEachShard(GenomeStore& store, int shardSize, const std::function<void(int, int)>& fn) {
+		for (int first = 0; first < store.size(); first += shardSize) {
+			int count = std::min(shardSize, store.size() - first);
+			if (!store.mapShard(first, count)) {
+				std::cout << std::format("Failed to map population records {} - {}", first, first + count - 1) << std::endl;
+				return false;
+			}
+			fn(first, count);
+		}
+		store.unmap();
+
+		return true;
+	}
+
+	EvolutionResult evolveOutOfCore(const SnakeConfiguration& config, WorkerPool& pool, std::vector<SnakeBrain>& replaySnakeBrains, int& useSnakeBrainGeneration, TrajectoryRecorder* recorder) {
+		const int numBrains = config.evolution.numSnakeBrains;
+		const bool print = config.evolution.printProgress;
+		SnakeBrain templateBrain(config.numInputs(), config.brain.numHiddenLayers, config.brain.hiddenLayerSize, config.brain.outputLayerSize);
+		const int genomeSize = templateBrain.genomeSize();
+
+		// The current generation is evaluated in one file and bred into the other, then they switch places
+		GenomeStore stores[2];
+		if (!stores[0].create(config.population.path1, numBrains, templateBrain) || !stores[1].create(config.population.path2, numBrains, templateBrain)) {
+			std::cout << std::format("Failed to create population files {} and {}", config.population.path1, config.population.path2) << std::endl;
+			return {};
+		}
+
+		const long long halfBudget = static_cast<long long>(config.population.memoryBudgetMB) * 1024 * 1024 / 2;
+		const int shardSize = static_cast<int>(std::clamp<long long>(halfBudget / stores[0].recordStride(), 1, numBrains));
+		const int maxParents = static_cast<int>(std::clamp<long long>(halfBudget / (genomeSize * static_cast<long long>(sizeof(float))), 2, numBrains));
+		const int numParents = std::clamp(static_cast<int>(numBrains * config.evolution.partOfParentsUsedForCrossover), 2, maxParents);
+
+		if (print) {
+			std::cout << std::format("Running out-of-core evolution with {} threads, {} brains per shard and {} parents\n-----\n", pool.size(), shardSize, numParents);
+			std::cout << std::format("Gen\tMax score\tTime (s)") << std::endl;
+		}
+
+		auto decode = [&templateBrain](std::span<const float> genome) {
+			SnakeBrain brain = templateBrain.clone();
+			brain.setGenome(genome);
+			return brain;
+		};
+		// One brain per worker that genomes are decoded into for evaluation. After the first decode it owns all of
+		//	its perceptrons, so the next ones are written in place without allocating
+		std::vector<SnakeBrain> workerBrains(pool.size(), templateBrain);
+		// Two per worker that the parents are decoded into for breeding
+		std::vector<SnakeBrain> workerParents(2 * pool.size(), templateBrain);
+		std::vector<EvaluationStats> workerStats(pool.size());
+		for (auto& brain : workerBrains) {
+			brain.setDecisionCache(config.brain.decisionCacheSize);
+		}
+
+		int idxCurrent = 0;
+		bool ok = forEachShard(stores[idxCurrent], shardSize, [&](int first, int count) {
+			pool.parallelFor(count, [&](int idx) {
+				SnakeBrain brain(config.numInputs(), config.brain.numHiddenLayers, config.brain.hiddenLayerSize, config.brain.outputLayerSize);
+				brain.toGenome(stores[idxCurrent].genome(first + idx));
+				});
+			});
+
+		auto bestGenerationScore = 0;
+		std::vector<int> fitness(numBrains);
+		std::atomic<long long> numSteps = 0;
+		long long numGames = 0;
+
+		for (int gen = 0; ok && gen < config.evolution.numGenerations; gen++) {
+			auto genStartTime = SDL_GetTicks64();
+			GenomeStore& current = stores[idxCurrent];
+			GenomeStore& next = stores[1 - idxCurrent];
+
+			{
+				TRACE_SCOPE("evaluatePopulation");
+				ok = forEachShard(current, shardSize, [&](int first, int count) {
+					pool.parallelFor(count, [&](int idx) {
+						SnakeBrain& brain = workerBrains[WorkerPool::currentWorker()];
+						brain.setGenome(current.genome(first + idx));
+						prepareBlockedBrain(config, brain);
+						Arena* arena = WorkerPool::currentArena();
+						{
+							Game game(config, &brain, config.game.numSquares, config.game.numSquares, config.game.trainingRoundTime, arena->resource());
+							selectForRecording(recorder, game);
+							game.play();
+							fitness[first + idx] = game.fitness();
+							numSteps += game.stepsPlayed();
+						}
+						arena->reset();
+						collectDecisionCacheStats(brain, workerStats[WorkerPool::currentWorker()]);
+						current.fitness(first + idx) = fitness[first + idx];
+						});
+					});
+			}
+			numGames += numBrains;
+
+			// Only the parents are needed for breeding, so we don't have to sort all brains
+			std::vector<int> ranking(numBrains);
+			std::iota(ranking.begin(), ranking.end(), 0);
+			std::partial_sort(ranking.begin(), ranking.begin() + numParents, ranking.end(), [&fitness](int a, int b) {return fitness[a] > fitness[b] || (fitness[a] == fitness[b] && a < b); });
+			ranking.resize(numParents);
+
+			// Parents are read in file order, one shard at a time, but kept in ranking order; the best brain is first
+			std::vector<int> parentOrder(numParents);
+			std::iota(parentOrder.begin(), parentOrder.end(), 0);
+			std::sort(parentOrder.begin(), parentOrder.end(), [&ranking](int a, int b) {return ranking[a] < ranking[b]; });
+			// Kept as genomes, so they take exactly the memory budgeted for them. A SnakeBrain would add a perceptron
+			//	with its own vector and shared pointer for every neuron
+			std::vector<float> parentGenomes(static_cast<size_t>(numParents) * genomeSize);
+			auto parentGenome = [&parentGenomes, genomeSize](int idxParent) {
+				return std::span<float>(parentGenomes.data() + static_cast<size_t>(idxParent) * genomeSize, genomeSize);
+			};
+			{
+				TRACE_SCOPE("loadParents");
+				int idxOrder = 0;
+				ok = ok && forEachShard(current, shardSize, [&](int first, int count) {
+					for (; idxOrder < numParents && ranking[parentOrder[idxOrder]] < first + count; idxOrder++) {
+						auto genome = current.genome(ranking[parentOrder[idxOrder]]);
+						std::copy(genome.begin(), genome.end(), parentGenome(parentOrder[idxOrder]).begin());
+					}
+					});
+			}
+
+			auto maxScore = fitness[ranking.front()];
 			auto genTimeS = (SDL_GetTicks64() - genStartTime) / 1000.0f;
-			std::cout << std::format("{}\t{}\t\t{}", gen + 1, maxScore, genTimeS) << std::endl;
+			if (print) {
+				std::cout << std::format("{}\t{}\t\t{}", gen + 1, maxScore, genTimeS) << std::endl;
+			}
 
 			if (maxScore > bestGenerationScore) {
 				useSnakeBrainGeneration = gen;
 				bestGenerationScore = maxScore;
 			}
 
-			replaySnakeBrains.push_back(bestBrainInGeneration->clone());
+			replaySnakeBrains.push_back(decode(parentGenome(0)));
 
-			// Time to evolve!
-			if (gen < SnakeConfiguration::Evolution::numGenerations - 1) {
-				std::vector<SnakeBrain> newSnakeBrains;
-				// Keep the best brain of each generation
-				newSnakeBrains.push_back(bestBrainInGeneration->clone());
-				// TODO: Think of good criteria for a parent
-				int numParents = std::max(2, static_cast<int>(SnakeConfiguration::Evolution::numSnakeBrains * SnakeConfiguration::Evolution::partOfParentsUsedForCrossover));
-				std::vector<SnakeBrain*> parents;
-				parents.reserve(numParents);
-				for (int i = 0; i < numParents; i++) {
-					parents.push_back(std::get<1>(brainsWithScore[i]));
-				}
-				// Start at one, since we already added the currently best brain to the vector
-				for (int childIdx = 1; childIdx < SnakeConfiguration::Evolution::numSnakeBrains; childIdx++) {
-					auto parentIdx1 = 0;
-					auto parentIdx2 = 0;
-					// Make sure the parents are two different individuals
-					while (parentIdx1 == parentIdx2) {
-						parentIdx1 = getRandomInt(0, numParents - 1);
-						parentIdx2 = getRandomInt(0, numParents - 1);
-					}
-					SnakeBrain child = ClSnake::makeChild(parents[parentIdx1], parents[parentIdx2], SnakeConfiguration::Evolution::mutationProbability);
-					newSnakeBrains.push_back(child);
+			if (config.evolution.targetFitness > 0 && maxScore >= config.evolution.targetFitness) {
+				if (print) {
+					std::cout << std::format("Reached target fitness {}", config.evolution.targetFitness) << std::endl;
 				}
-				snakeBrains = newSnakeBrains;
+				break;
+			}
+
+			if (!ok || gen == config.evolution.numGenerations - 1) {
+				break;
+			}
+
+			// Time to evolve! Same as GeneticOptimizer: keep the best brain, breed the rest from the parents
+			{
+				TRACE_SCOPE("reproduction");
+				ok = forEachShard(next, shardSize, [&](int first, int count) {
+					pool.parallelFor(count, [&](int idx) {
+						int idxChild = first + idx;
+						next.fitness(idxChild) = 0;
+						if (idxChild == 0) {
+							auto best = parentGenome(0);
+							std::copy(best.begin(), best.end(), next.genome(idxChild).begin());
+							return;
+						}
+						auto parentIdx1 = 0;
+						auto parentIdx2 = 0;
+						// Make sure the parents are two different individuals
+						while (parentIdx1 == parentIdx2) {
+							parentIdx1 = getRandomInt(0, numParents - 1);
+							parentIdx2 = getRandomInt(0, numParents - 1);
+						}
+						SnakeBrain& parent1 = workerParents[2 * WorkerPool::currentWorker()];
+						SnakeBrain& parent2 = workerParents[2 * WorkerPool::currentWorker() + 1];
+						parent1.setGenome(parentGenome(parentIdx1));
+						parent2.setGenome(parentGenome(parentIdx2));
+						ClSnake::makeChild(&parent1, &parent2, config.evolution.mutationProbability).toGenome(next.genome(idxChild));
+						});
+					});
+			}
+			idxCurrent = 1 - idxCurrent;
+		}
+
+		if (print) {
+			std::cout << std::format("Simulated {} games ({} steps)", numGames, numSteps.load()) << std::endl;
+			EvaluationStats stats;
+			for (auto& w : workerStats) {
+				stats.add(w);
+			}
+			printDecisionCacheStats(stats);
+		}
+
+		return { bestGenerationScore, numGames, numSteps.load() };
+	}
+
+	EvolutionResult evolve(const SnakeConfiguration& config, WorkerPool& pool, std::vector<SnakeBrain>& replaySnakeBrains, int& useSnakeBrainGeneration) {
+		// Eg. out-of-core and steady-state would otherwise quietly ignore the optimizer and the evaluation settings
+		if (!config.validate()) {
+			return {};
+		}
+
+		std::unique_ptr<TrajectoryRecorder> recorder;
+		if (config.record.enabled) {
+			recorder = std::make_unique<TrajectoryRecorder>(config.record.outputPath, config.numInputs(), config.brain.numHiddenLayers * config.brain.hiddenLayerSize,
+				config.record.everyNthGame, config.record.batchRows, pool.size());
+			if (!recorder->isOpen()) {
+				std::cout << std::format("Failed to open {}, games are not recorded", config.record.outputPath) << std::endl;
+				recorder = nullptr;
 			}
 		}
+
+		EvolutionResult result;
+		if (config.population.outOfCore) {
+			result = evolveOutOfCore(config, pool, replaySnakeBrains, useSnakeBrainGeneration, recorder.get());
+		}
+		else if (config.evolution.mode == EvolutionMode::SteadyState) {
+			result = evolveSteadyState(config, pool, replaySnakeBrains, useSnakeBrainGeneration, recorder.get());
+		}
+		else {
+			result = evolveGenerational(config, pool, replaySnakeBrains, useSnakeBrainGeneration, recorder.get());
+		}
+
+		if (recorder != nullptr && config.evolution.printProgress) {
+			std::cout << std::format("Recorded {} steps to {}", recorder->numRecordedSteps(), config.record.outputPath) << std::endl;
+		}
+
+		return result;
+	}
+
+	EvolutionResult evolve(const SnakeConfiguration& config, std::vector<SnakeBrain>& replaySnakeBrains, int& useSnakeBrainGeneration) {
+		WorkerPool pool(config.threads.numThreads, config.threads.affinity, config.threads.arenaBytes);
+		auto result = evolve(config, pool, replaySnakeBrains, useSnakeBrainGeneration);
+
+		TRACE_DUMP(config.trace.outputPath);
+
+		return result;
 	}
 }
\ No newline at end of file
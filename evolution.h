@@ -2,6 +2,7 @@
 
 #include "snake.h"
 #include "config.h"
+#include "worker_pool.h"
 
 namespace ClSnake {
 
@@ -11,5 +12,16 @@ namespace ClSnake {
 	void mutate(SnakeBrain* brain, float probability);
 	// Probability for mutation, on range 0 - 1
 	SnakeBrain makeChild(SnakeBrain* parent1, SnakeBrain* parent2, float mutationProbability);
-	void evolve(std::vector<SnakeBrain>& replaySnakeBrains, int& useSnakeBrainGeneration);
+
+	struct EvolutionResult {
+		int bestFitness = 0;
+		long long numGames = 0;
+		long long numSteps = 0;
+	};
+
+	// Runs the evolution described by config. The best brain of each generation is added to replaySnakeBrains.
+	//	Nothing is run if config doesn't pass SnakeConfiguration::validate()
+	EvolutionResult evolve(const SnakeConfiguration& config, std::vector<SnakeBrain>& replaySnakeBrains, int& useSnakeBrainGeneration);
+	// Same, but evaluates on a pool that can be shared with other runs. config.threads is not used
+	EvolutionResult evolve(const SnakeConfiguration& config, WorkerPool& pool, std::vector<SnakeBrain>& replaySnakeBrains, int& useSnakeBrainGeneration);
 }
\ No newline at end of file
@@ -1,31 +1,41 @@
+#include <algorithm>
+
 #include "game.h"
 
 #pragma once
 
 #include "snake.h"
 #include "config.h"
+#include "trace.h"
 
 
-void MeasureSquares::clear() {
-	body.clear();
-	food.clear();
-	wall.clear();
-}
-
-
-Game::Game(SnakeBrain* brain, int tBoardWidth, int tBoardHeight, int roundTime) {
+Game::Game(const SnakeConfiguration& tConfig, SnakeBrain* brain, int tBoardWidth, int tBoardHeight, int roundTime, std::pmr::memory_resource* tResource) : config(&tConfig), resource(tResource), measurements(tResource),
+	raySensor(tBoardWidth, tBoardHeight, tResource), windowSensor(tBoardWidth, tBoardHeight, tConfig.game.windowSize, tResource) {
 	boardWidth = tBoardWidth;
 	boardHeight = tBoardHeight;
 	startingPosition = Vec2i(boardWidth / 2, boardHeight / 2);
-	snake = new Snake(brain, startingPosition);
+	snake = std::pmr::polymorphic_allocator<Snake>(resource).new_object<Snake>(brain, startingPosition, resource);
+	if (config->game.sensor == SensorType::Window) {
+		sensor = &windowSensor;
+	}
+	else if (config->game.incrementalSensing && boardWidth <= Sensor::maxBoardSize && boardHeight <= Sensor::maxBoardSize) {
+		sensor = &raySensor;
+	}
+	if (sensor != nullptr) {
+		sensor->reset(snake);
+	}
 	totalTimeLeft = maxTime;
 	timeLeft = roundTime;
 	foodPosition = generateFoodPosition();
 }
 
 Game::~Game() {
+	// Also the steps of a game that was cut short
+	if (recorder != nullptr) {
+		recorder->endGame(std::move(recordedSteps));
+	}
 	if (snake != nullptr) {
-		delete snake;
+		std::pmr::polymorphic_allocator<Snake>(resource).delete_object(snake);
 	}
 }
 
@@ -37,6 +47,10 @@ bool Game::isCrash(Snake* snake, Vec2i pt) {
 		return true;
 	}
 
+	if (sensor != nullptr && snake == this->snake) {
+		return sensor->isBody(pt);
+	}
+
 	auto iter = std::find_if(snake->body.begin(), snake->body.end(), [&pt](Vec2i v) {return v == pt; });
 
 	auto didCrash = (iter != snake->body.end());
@@ -45,21 +59,46 @@ bool Game::isCrash(Snake* snake, Vec2i pt) {
 }
 
 bool Game::playStep(bool isManual, SnakeMove* snakeMove, MeasureSquares* measureSquares) {
-	auto measurements = measure(snake, measureSquares);
+	TRACE_STEP_SCOPE("Game::playStep", config->trace.stepSampleEvery);
+	auto& measurements = measure(snake, measureSquares);
+	SnakeMove move = SnakeMove::Forward;
 
 	if (isManual) {
 		if (snakeMove != nullptr) {
-			snake->updateDirection(*snakeMove);
+			move = *snakeMove;
 		}
 	}
 	else {
-		auto brainOutput = snake->think(measurements);
-		snake->updateDirection(brainOutput);
+		move = snake->think(measurements);
 	}
+	snake->updateDirection(move);
 
+	if (recorder == nullptr) {
+		return advance();
+	}
+
+	int step = stepsPlayed();
+	int fitnessBefore = fitness();
+	bool goOn = advance();
+	recorder->addStep(recordedSteps, recordedGame, step, measurements, snake->hiddenActivations(), move, fitness() - fitnessBefore, !goOn);
+
+	return goOn;
+}
+
+bool Game::advance() {
 	bool didCrash = isCrash(snake, snake->nextPosition());
+	Vec2i tailPosition = snake->body.front();
+	bool removesTail = !snake->ateLastMove;
 	snake->move();
 
+	// Only the new head and the old tail changed
+	if (sensor != nullptr && !didCrash) {
+		sensor->addBody(snake->position);
+		if (removesTail) {
+			sensor->removeBody(tailPosition);
+		}
+	}
+
 	if (didCrash) {
 		snake->isAlive = false;
 		return false;
@@ -67,7 +106,7 @@ bool Game::playStep(bool isManual, SnakeMove* snakeMove, MeasureSquares* measure
 	if (snake->position == foodPosition) {
 		snake->ateLastMove = true;
 		foodPosition = generateFoodPosition();
-		timeLeft += SnakeConfiguration::Game::foodTimeAdd;
+		timeLeft += config->game.foodTimeAdd;
 	}
 	totalTimeLeft--;
 	timeLeft--;
@@ -79,29 +118,69 @@ bool Game::playStep(bool isManual, SnakeMove* snakeMove, MeasureSquares* measure
 	return true;
 }
 
+void Game::record(ClSnake::TrajectoryRecorder* tRecorder, uint32_t gameNumber) {
+	if (recorder != nullptr) {
+		recorder->endGame(std::move(recordedSteps));
+	}
+	recorder = tRecorder;
+	if (recorder != nullptr) {
+		recordedSteps = recorder->startGame();
+	}
+	recordedGame = gameNumber;
+	snake->setKeepHidden(recorder != nullptr);
+}
+
 Vec2i Game::getFoodPosition() {
 	return foodPosition;
 }
 
 int Game::fitness() {
 	auto totalPlayTime = maxTime - totalTimeLeft;
-	return snake->body.size() * SnakeConfiguration::Game::foodScore + totalPlayTime * SnakeConfiguration::Game::timeUnitScore;
+	return snake->body.size() * config->game.foodScore + totalPlayTime * config->game.timeUnitScore;
 }
 
+int Game::stepsPlayed() {
+	return maxTime - totalTimeLeft;
+}
 
 void Game::play() {
-	auto done = false;
+	TRACE_SCOPE("Game::play");
+	while (!over) {
+		over = !playStep(false);
+	}
+}
 
-	while (!done) {
-		done = !playStep(false);
+bool Game::playSteps(int numSteps) {
+	TRACE_SCOPE("Game::playSteps");
+	for (int i = 0; i < numSteps && !over; i++) {
+		over = !playStep(false);
 	}
+
+	return over;
 }
 
-std::vector<float> Game::measure(Snake* snake, MeasureSquares* measureSquares) {
+bool Game::isOver() {
+	return over;
+}
+
+const std::pmr::vector<float>& Game::measure(Snake* snake, MeasureSquares* measureSquares) {
+	TRACE_SAMPLED_SCOPE("Game::measure");
+
+	if (sensor != nullptr) {
+		sensor->measure(snake, foodPosition, measurements, measureSquares);
+	}
+	else {
+		measureFull(snake, measureSquares);
+	}
+
+	return measurements;
+}
+
+void Game::measureFull(Snake* snake, MeasureSquares* measureSquares) {
 
 	const int numMeasurements = 24;
 
-	std::vector<Vec2i> posDeltas = {
+	static const Vec2i posDeltas[] = {
 		Vec2i(-1, 1),
 		Vec2i(-1, 0),
 		Vec2i(-1, -1),
@@ -126,7 +205,7 @@ std::vector<float> Game::measure(Snake* snake, MeasureSquares* measureSquares) {
 	//	Measure: angle to food, (manhattan) distance to food, distance to wall (left, right, up down). 
 	// Then, add body. Measure left, right, forward. Think of a better measurement - body is the trickiest!
 
-	auto measurements = std::vector<float>(numMeasurements, 0);
+	measurements.assign(numMeasurements, 0);
 
 	// 8 squares, 3 measurements each
 	for (int idxDir = 0; idxDir < 8; idxDir++) {
@@ -170,11 +249,10 @@ std::vector<float> Game::measure(Snake* snake, MeasureSquares* measureSquares) {
 		measurements[idxStart + 1] = food;
 		measurements[idxStart + 2] = body;
 	}
-
-	return measurements;
 }
 
 Vec2i Game::generateFoodPosition() {
+	TRACE_SAMPLED_SCOPE("Game::generateFoodPosition");
 	const int maxIters = 10'000;
 
 	while (maxIters > 0) {
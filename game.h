@@ -1,19 +1,17 @@
 #pragma once
 
-#include "snake.h"
-
-struct MeasureSquares {
-	std::vector<Vec2i> body;
-	std::vector<Vec2i> food;
-	std::vector<Vec2i> wall;
+#include <memory_resource>
 
-	void clear();
-};
+#include "snake.h"
+#include "config.h"
+#include "sensor.h"
+#include "trajectory_recorder.h"
 
 class Game {
 public:
-	// Round time is important for training: keep it pretty high so the snake can learn!
-	Game(SnakeBrain* brain, int tBoardWidth, int tBoardHeight, int roundTime = 300);
+	// Everything the game needs is allocated from resource, eg. a worker arena that is reset after the game.
+	//	The configuration must outlive the game
+	Game(const SnakeConfiguration& tConfig, SnakeBrain* brain, int tBoardWidth, int tBoardHeight, int roundTime, std::pmr::memory_resource* tResource = std::pmr::get_default_resource());
 
 	~Game();
 
@@ -28,19 +26,39 @@ public:
 	// Returns the score
 	// This is used for fast play (eg. during training)
 	void play();
+	// Plays at most numSteps steps. Can be called again to resume the game. Returns true when the game is over
+	bool playSteps(int numSteps);
+	bool isOver();
+
+	// Records every step from now on, as game number gameNumber. The recorder must outlive the game
+	void record(ClSnake::TrajectoryRecorder* tRecorder, uint32_t gameNumber);
 
 	int fitness();
+	// Number of steps played so far
+	int stepsPlayed();
 
 	Snake* snake = nullptr;
 	int timeLeft;
 private:
+	const SnakeConfiguration* config;
+	std::pmr::memory_resource* resource;
 	int boardWidth;
 	int boardHeight;
 	// To make sure to stop the game if the snake is "too good"
 	const int maxTime = 50000;
 	int totalTimeLeft;
+	bool over = false;
 	Vec2i foodPosition;
 	Vec2i startingPosition;
+	// Reused between steps
+	std::pmr::vector<float> measurements;
+	// One of the sensors below, or nullptr when the rays are measured from scratch with measureFull()
+	Sensor* sensor = nullptr;
+	RaySensor raySensor;
+	WindowSensor windowSensor;
+	ClSnake::TrajectoryRecorder* recorder = nullptr;
+	uint32_t recordedGame = 0;
+	std::unique_ptr<ClSnake::TrajectoryRecorder::Batch> recordedSteps;
 
 	// First, measure from the squares around starting with the bottom left, going to the upper left and then around.
 	//
@@ -57,7 +75,12 @@ private:
 	// 7   3
 	// 6 5 4
 	//
-	// Returns normalized measurements
-	std::vector<float> measure(Snake* snake, MeasureSquares* measureSquares);
+	// Returns normalized measurements. They are overwritten by the next call
+	// Uses the sensor chosen in the configuration. For rays, that's the incremental RaySensor when possible, which
+	//	gives the same result as measureFull()
+	const std::pmr::vector<float>& measure(Snake* snake, MeasureSquares* measureSquares);
+	void measureFull(Snake* snake, MeasureSquares* measureSquares);
 	Vec2i generateFoodPosition();
+	// Moves the snake after its direction has been decided. Returns true if we should go on
+	bool advance();
 };
\ No newline at end of file
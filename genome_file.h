@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+// File format of a saved brain, shared by the training code and the inference library:
+//	a GenomeFileHeader followed by the genome as 32-bit floats. The genome is laid out as by SnakeBrain::toGenome():
+//	perceptron by perceptron, layer by layer, each with its weights followed by its bias.
+//	All hidden layers use relu, and so does the output layer.
+struct GenomeFileHeader {
+	char magic[4] = { 'C', 'L', 'S', 'B' };
+	uint32_t version = 1;
+	int32_t numInputs = 0;
+	int32_t numHiddenLayers = 0;
+	int32_t hiddenLayerSize = 0;
+	int32_t outputLayerSize = 0;
+	// Number of floats that follow the header
+	int32_t genomeSize = 0;
+};
+
+// File format of a population that is kept on disk during evolution, see GenomeStore: a PopulationFileHeader
+//	followed, at recordsOffset, by numGenomes records of recordStride bytes. Each record is the fitness as a 32-bit
+//	int followed by genomeSize floats laid out as above
+struct PopulationFileHeader {
+	char magic[4] = { 'C', 'L', 'S', 'P' };
+	uint32_t version = 1;
+	int32_t numInputs = 0;
+	int32_t numHiddenLayers = 0;
+	int32_t hiddenLayerSize = 0;
+	int32_t outputLayerSize = 0;
+	int32_t genomeSize = 0;
+	int32_t numGenomes = 0;
+	int32_t recordStride = 0;
+	int32_t recordsOffset = 0;
+};
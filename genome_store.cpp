@@ -0,0 +1,73 @@
+#include <cstring>
+
+#include "genome_store.h"
+#include "genome_file.h"
+
+namespace ClSnake {
+
+	bool GenomeStore::create(const std::string& path, int tNumGenomes, SnakeBrain& brain) {
+		numGenomes = tNumGenomes;
+		genomeSize = brain.genomeSize();
+		// Whole cache lines per record, so two workers never write to the same line
+		const int cacheLine = 64;
+		stride = (static_cast<int>(sizeof(int32_t) + genomeSize * sizeof(float)) + cacheLine - 1) / cacheLine * cacheLine;
+		recordsOffset = (static_cast<int>(sizeof(PopulationFileHeader)) + cacheLine - 1) / cacheLine * cacheLine;
+
+		if (!file.create(path, recordsOffset + static_cast<uint64_t>(stride) * numGenomes)) {
+			return false;
+		}
+
+		PopulationFileHeader header;
+		header.numInputs = brain.numInputs;
+		header.numHiddenLayers = brain.numHiddenLayers;
+		header.hiddenLayerSize = brain.hiddenLayerSize;
+		header.outputLayerSize = brain.outputLayerSize;
+		header.genomeSize = genomeSize;
+		header.numGenomes = numGenomes;
+		header.recordStride = stride;
+		header.recordsOffset = recordsOffset;
+
+		std::byte* data = file.map(0, sizeof(header));
+		if (data == nullptr) {
+			return false;
+		}
+		std::memcpy(data, &header, sizeof(header));
+		file.unmap();
+
+		return true;
+	}
+
+	int GenomeStore::size() {
+		return numGenomes;
+	}
+
+	int GenomeStore::recordStride() {
+		return stride;
+	}
+
+	bool GenomeStore::mapShard(int first, int count) {
+		shard = file.map(recordsOffset + static_cast<uint64_t>(stride) * first, static_cast<size_t>(stride) * count);
+		shardFirst = first;
+		shardCount = (shard != nullptr) ? count : 0;
+
+		return shard != nullptr;
+	}
+
+	void GenomeStore::unmap() {
+		file.unmap();
+		shard = nullptr;
+		shardCount = 0;
+	}
+
+	std::span<float> GenomeStore::genome(int idx) {
+		std::byte* record = shard + static_cast<size_t>(stride) * (idx - shardFirst);
+
+		return std::span<float>(reinterpret_cast<float*>(record + sizeof(int32_t)), genomeSize);
+	}
+
+	int32_t& GenomeStore::fitness(int idx) {
+		std::byte* record = shard + static_cast<size_t>(stride) * (idx - shardFirst);
+
+		return *reinterpret_cast<int32_t*>(record);
+	}
+}
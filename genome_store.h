@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <span>
+#include <cstdint>
+
+#include "snake.h"
+#include "mapped_file.h"
+
+namespace ClSnake {
+
+	// Population of fixed size genomes with their fitness in a memory mapped file, in the format described by
+	//	PopulationFileHeader in genome_file.h. Only one shard (a range of records) is mapped at a time
+	class GenomeStore {
+	public:
+		// Creates the file for numGenomes brains shaped like brain. Returns false on failure
+		bool create(const std::string& path, int tNumGenomes, SnakeBrain& brain);
+		int size();
+		// Bytes per record in the file
+		int recordStride();
+		// Maps records first to first+count-1, replacing the previous shard. Returns false on failure
+		bool mapShard(int first, int count);
+		void unmap();
+		// Only valid for records in the current shard
+		std::span<float> genome(int idx);
+		int32_t& fitness(int idx);
+	private:
+		MappedFile file;
+		int numGenomes = 0;
+		int genomeSize = 0;
+		int stride = 0;
+		int recordsOffset = 0;
+		int shardFirst = 0;
+		int shardCount = 0;
+		std::byte* shard = nullptr;
+	};
+}
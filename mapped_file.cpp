@@ -0,0 +1,139 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace ClSnake {
+
+	MappedFile::~MappedFile() {
+		close();
+	}
+
+#ifdef _WIN32
+
+	bool MappedFile::create(const std::string& path, uint64_t numBytes) {
+		close();
+
+		file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			file = nullptr;
+			return false;
+		}
+
+		// The mapping grows the file to its full size
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(numBytes >> 32), static_cast<DWORD>(numBytes), nullptr);
+		if (mapping == nullptr) {
+			close();
+			return false;
+		}
+
+		return true;
+	}
+
+	std::byte* MappedFile::map(uint64_t offset, size_t numBytes) {
+		unmap();
+
+		if (mapping == nullptr) {
+			return nullptr;
+		}
+
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		uint64_t alignedOffset = offset - offset % info.dwAllocationGranularity;
+		size_t alignedBytes = static_cast<size_t>(offset - alignedOffset) + numBytes;
+
+		view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, static_cast<DWORD>(alignedOffset >> 32), static_cast<DWORD>(alignedOffset), alignedBytes);
+		if (view == nullptr) {
+			return nullptr;
+		}
+		viewBytes = alignedBytes;
+
+		return static_cast<std::byte*>(view) + (offset - alignedOffset);
+	}
+
+	void MappedFile::unmap() {
+		if (view != nullptr) {
+			UnmapViewOfFile(view);
+			view = nullptr;
+			viewBytes = 0;
+		}
+	}
+
+	void MappedFile::close() {
+		unmap();
+
+		if (mapping != nullptr) {
+			CloseHandle(mapping);
+			mapping = nullptr;
+		}
+		if (file != nullptr) {
+			CloseHandle(file);
+			file = nullptr;
+		}
+	}
+
+#else
+
+	bool MappedFile::create(const std::string& path, uint64_t numBytes) {
+		close();
+
+		fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			return false;
+		}
+
+		if (ftruncate(fd, static_cast<off_t>(numBytes)) != 0) {
+			close();
+			return false;
+		}
+
+		return true;
+	}
+
+	std::byte* MappedFile::map(uint64_t offset, size_t numBytes) {
+		unmap();
+
+		if (fd < 0) {
+			return nullptr;
+		}
+
+		uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+		uint64_t alignedOffset = offset - offset % pageSize;
+		size_t alignedBytes = static_cast<size_t>(offset - alignedOffset) + numBytes;
+
+		view = mmap(nullptr, alignedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(alignedOffset));
+		if (view == MAP_FAILED) {
+			view = nullptr;
+			return nullptr;
+		}
+		viewBytes = alignedBytes;
+
+		return static_cast<std::byte*>(view) + (offset - alignedOffset);
+	}
+
+	void MappedFile::unmap() {
+		if (view != nullptr) {
+			munmap(view, viewBytes);
+			view = nullptr;
+			viewBytes = 0;
+		}
+	}
+
+	void MappedFile::close() {
+		unmap();
+
+		if (fd >= 0) {
+			::close(fd);
+			fd = -1;
+		}
+	}
+
+#endif
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace ClSnake {
+
+	// File that is read and written through a memory mapped window. Only one window is mapped at a time, so only
+	//	that part of the file counts towards the memory of the process, no matter how large the file is
+	class MappedFile {
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile();
+
+		// Creates the file with a size of numBytes, replacing any existing file. Returns false on failure
+		bool create(const std::string& path, uint64_t numBytes);
+		// Maps numBytes starting at offset for reading and writing, replacing the previous window. Returns nullptr on failure
+		std::byte* map(uint64_t offset, size_t numBytes);
+		void unmap();
+		void close();
+	private:
+#ifdef _WIN32
+		void* file = nullptr;
+		void* mapping = nullptr;
+#else
+		int fd = -1;
+#endif
+		// Start of the mapping, which is aligned down from the requested offset
+		void* view = nullptr;
+		size_t viewBytes = 0;
+	};
+}
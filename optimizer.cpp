@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+#include "optimizer.h"
+#include "evolution.h"
+#include "pruning.h"
+
+namespace ClSnake {
+
+	GeneticOptimizer::GeneticOptimizer(const SnakeConfiguration& tConfig) : config(tConfig) {
+		for (int i = 0; i < config.evolution.numSnakeBrains; i++) {
+			SnakeBrain brain(config.numInputs(), config.brain.numHiddenLayers, config.brain.hiddenLayerSize, config.brain.outputLayerSize);
+			snakeBrains.push_back(brain);
+		}
+	}
+
+	std::vector<SnakeBrain>& GeneticOptimizer::population() {
+		return snakeBrains;
+	}
+
+	void GeneticOptimizer::tell(const std::vector<int>& fitness) {
+		std::vector<int> ranking(snakeBrains.size());
+		std::iota(ranking.begin(), ranking.end(), 0);
+		std::stable_sort(ranking.begin(), ranking.end(), [&fitness](int a, int b) {return fitness[a] > fitness[b]; });
+
+		std::vector<SnakeBrain> newSnakeBrains;
+		newSnakeBrains.reserve(config.evolution.numSnakeBrains);
+		// Keep the best brain of each generation
+		newSnakeBrains.push_back(snakeBrains[ranking.front()].clone());
+		if (config.pruning.elites) {
+			prune(config, newSnakeBrains.front());
+		}
+		// TODO: Think of good criteria for a parent
+		int numParents = std::max(2, static_cast<int>(config.evolution.numSnakeBrains * config.evolution.partOfParentsUsedForCrossover));
+		std::vector<SnakeBrain*> parents;
+		parents.reserve(numParents);
+		for (int i = 0; i < numParents; i++) {
+			parents.push_back(&snakeBrains[ranking[i]]);
+		}
+		// Start at one, since we already added the currently best brain to the vector
+		for (int childIdx = 1; childIdx < config.evolution.numSnakeBrains; childIdx++) {
+			auto parentIdx1 = 0;
+			auto parentIdx2 = 0;
+			// Make sure the parents are two different individuals
+			while (parentIdx1 == parentIdx2) {
+				parentIdx1 = getRandomInt(0, numParents - 1);
+				parentIdx2 = getRandomInt(0, numParents - 1);
+			}
+			newSnakeBrains.push_back(ClSnake::makeChild(parents[parentIdx1], parents[parentIdx2], config.evolution.mutationProbability));
+		}
+		snakeBrains = std::move(newSnakeBrains);
+	}
+
+	const char* GeneticOptimizer::name() {
+		return "genetic algorithm";
+	}
+
+	EvolutionStrategyOptimizer::EvolutionStrategyOptimizer(const SnakeConfiguration& tConfig) : config(tConfig) {
+		SnakeBrain brain(config.numInputs(), config.brain.numHiddenLayers, config.brain.hiddenLayerSize, config.brain.outputLayerSize);
+
+		mean = brain.toGenome();
+		m.assign(mean.size(), 0.0f);
+		v.assign(mean.size(), 0.0f);
+
+		// Candidates come in mirrored pairs
+		int numPairs = std::max(1, config.evolutionStrategy.populationSize / 2);
+		candidates.assign(numPairs * 2, brain);
+		noise.resize(numPairs);
+
+		samplePopulation();
+	}
+
+	std::vector<SnakeBrain>& EvolutionStrategyOptimizer::population() {
+		return candidates;
+	}
+
+	void EvolutionStrategyOptimizer::samplePopulation() {
+		const float sigma = config.evolutionStrategy.sigma;
+		std::vector<float> genome(mean.size());
+
+		for (int idxPair = 0; idxPair < noise.size(); idxPair++) {
+			noise[idxPair] = getRandomNormals(0.0f, 1.0f, static_cast<int>(mean.size()));
+			auto& eps = noise[idxPair];
+
+			for (int i = 0; i < mean.size(); i++) {
+				genome[i] = mean[i] + sigma * eps[i];
+			}
+			candidates[idxPair * 2].setGenome(genome);
+
+			for (int i = 0; i < mean.size(); i++) {
+				genome[i] = mean[i] - sigma * eps[i];
+			}
+			candidates[idxPair * 2 + 1].setGenome(genome);
+		}
+	}
+
+	void EvolutionStrategyOptimizer::tell(const std::vector<int>& fitness) {
+		const float sigma = config.evolutionStrategy.sigma;
+		const float learningRate = config.evolutionStrategy.learningRate;
+		const float beta1 = 0.9f;
+		const float beta2 = 0.999f;
+		const int numCandidates = static_cast<int>(candidates.size());
+
+		// Fitness shaping: use centered ranks on range -0.5 - 0.5 instead of raw fitness,
+		//	so a single lucky game (eg. one with a lot of food) doesn't dominate the update
+		std::vector<int> ranking(numCandidates);
+		std::iota(ranking.begin(), ranking.end(), 0);
+		std::stable_sort(ranking.begin(), ranking.end(), [&fitness](int a, int b) {return fitness[a] < fitness[b]; });
+
+		// Equal fitness gets equal (average) rank; a lot of brains just circle until the time is up
+		std::vector<float> shaped(numCandidates);
+		for (int rankStart = 0; rankStart < numCandidates;) {
+			int rankEnd = rankStart;
+			while (rankEnd < numCandidates && fitness[ranking[rankEnd]] == fitness[ranking[rankStart]]) {
+				rankEnd++;
+			}
+			float rank = (rankStart + rankEnd - 1) / 2.0f;
+			for (int i = rankStart; i < rankEnd; i++) {
+				shaped[ranking[i]] = rank / std::max(1, numCandidates - 1) - 0.5f;
+			}
+			rankStart = rankEnd;
+		}
+
+		std::vector<float> gradient(mean.size(), 0.0f);
+		for (int idxPair = 0; idxPair < noise.size(); idxPair++) {
+			float weight = shaped[idxPair * 2] - shaped[idxPair * 2 + 1];
+			auto& eps = noise[idxPair];
+			for (int i = 0; i < mean.size(); i++) {
+				gradient[i] += weight * eps[i];
+			}
+		}
+
+		numSteps++;
+		float correction1 = 1.0f - std::pow(beta1, static_cast<float>(numSteps));
+		float correction2 = 1.0f - std::pow(beta2, static_cast<float>(numSteps));
+
+		for (int i = 0; i < mean.size(); i++) {
+			float g = gradient[i] / (numCandidates * sigma);
+			m[i] = beta1 * m[i] + (1.0f - beta1) * g;
+			v[i] = beta2 * v[i] + (1.0f - beta2) * g * g;
+			// Gradient ascent, since we maximize fitness
+			mean[i] += learningRate * (m[i] / correction1) / (std::sqrt(v[i] / correction2) + 1e-8f);
+		}
+
+		samplePopulation();
+	}
+
+	const char* EvolutionStrategyOptimizer::name() {
+		return "evolution strategy";
+	}
+
+	std::unique_ptr<Optimizer> makeOptimizer(const SnakeConfiguration& config) {
+		switch (config.evolution.optimizer) {
+		case OptimizerType::EvolutionStrategy: return std::make_unique<EvolutionStrategyOptimizer>(config);
+		case OptimizerType::Genetic:
+		default: return std::make_unique<GeneticOptimizer>(config);
+		}
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include "snake.h"
+#include "config.h"
+
+namespace ClSnake {
+
+	// Ask/tell interface shared by the optimizers: evaluate population(), report the fitness with tell(), repeat
+	class Optimizer {
+	public:
+		virtual ~Optimizer() = default;
+		// Brains to evaluate in the current generation
+		virtual std::vector<SnakeBrain>& population() = 0;
+		// Fitness of each brain in population(), in the same order. Prepares the next generation
+		virtual void tell(const std::vector<int>& fitness) = 0;
+		virtual const char* name() = 0;
+	};
+
+	// Truncation selection of the best brains, uniform crossover and reset mutation. Keeps the best brain as is
+	class GeneticOptimizer : public Optimizer {
+	public:
+		GeneticOptimizer(const SnakeConfiguration& tConfig);
+		std::vector<SnakeBrain>& population() override;
+		void tell(const std::vector<int>& fitness) override;
+		const char* name() override;
+	private:
+		SnakeConfiguration config;
+		std::vector<SnakeBrain> snakeBrains;
+	};
+
+	// OpenAI-ES: samples mirrored pairs of gaussian perturbations around a mean genome and moves the mean
+	//	along the rank weighted perturbations, using Adam
+	class EvolutionStrategyOptimizer : public Optimizer {
+	public:
+		EvolutionStrategyOptimizer(const SnakeConfiguration& tConfig);
+		std::vector<SnakeBrain>& population() override;
+		void tell(const std::vector<int>& fitness) override;
+		const char* name() override;
+	private:
+		SnakeConfiguration config;
+		std::vector<float> mean;
+		// One noise vector per pair of candidates
+		std::vector<std::vector<float>> noise;
+		std::vector<SnakeBrain> candidates;
+		// Adam state
+		std::vector<float> m;
+		std::vector<float> v;
+		int numSteps = 0;
+
+		void samplePopulation();
+	};
+
+	// Uses config.evolution.optimizer
+	std::unique_ptr<Optimizer> makeOptimizer(const SnakeConfiguration& config);
+}
@@ -0,0 +1,148 @@
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <format>
+#include <limits>
+
+#include "pruning.h"
+#include "game.h"
+#include "sparse_brain.h"
+
+namespace ClSnake {
+
+	namespace {
+		// Seeds the games so each brain sees the same boards
+		const unsigned int probeSeed = 1000;
+
+		const int numTimedThinks = 20000;
+		const int numTimings = 5;
+
+		// Plays numGames seeded games. If everFired is given, sets everFired[i] for each hidden neuron i
+		//	that is active in some step
+		// Returns the average fitness
+		float probe(const SnakeConfiguration& config, SnakeBrain& brain, int numGames, std::vector<bool>* everFired) {
+			long long totalFitness = 0;
+			// Seeding restarts the random numbers of the thread, so carry on from a random seed afterwards
+			const unsigned int resumeSeed = static_cast<unsigned int>(getRandomInt(0, std::numeric_limits<int>::max()));
+
+			for (int idxGame = 0; idxGame < numGames; idxGame++) {
+				setRandomSeed(probeSeed + idxGame);
+				Game game(config, &brain, config.game.numSquares, config.game.numSquares, config.game.trainingRoundTime);
+				game.snake->setKeepHidden(everFired != nullptr);
+
+				while (!game.playSteps(1)) {
+					if (everFired != nullptr) {
+						auto hidden = game.snake->hiddenActivations();
+						for (int i = 0; i < hidden.size(); i++) {
+							if (hidden[i] > 0.0f) {
+								(*everFired)[i] = true;
+							}
+						}
+					}
+				}
+				totalFitness += game.fitness();
+			}
+			setRandomSeed(resumeSeed);
+
+			return numGames > 0 ? static_cast<float>(totalFitness) / numGames : 0.0f;
+		}
+
+		// Best of a few timings. What think costs doesn't depend on the inputs, so random ones will do
+		float timeThink(SnakeBrain& brain, const std::vector<std::vector<float>>& inputs) {
+			ThinkBuffers buffers;
+			float bestNs = std::numeric_limits<float>::max();
+			float sink = 0;
+
+			for (int idxTiming = 0; idxTiming < numTimings; idxTiming++) {
+				auto start = std::chrono::steady_clock::now();
+				for (auto& input : inputs) {
+					sink += brain.think(std::span<const float>(input), buffers)[0];
+				}
+				auto elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+				bestNs = std::min(bestNs, static_cast<float>(elapsedNs) / inputs.size());
+			}
+			// Keeps the compiler from dropping the thinking
+			volatile float keep = sink;
+			(void)keep;
+
+			return bestNs;
+		}
+	}
+
+	PruneStats prune(const SnakeConfiguration& config, SnakeBrain& brain) {
+		PruneStats stats;
+		const int numHidden = brain.numHiddenLayers * brain.hiddenLayerSize;
+		std::vector<bool> everFired(numHidden, false);
+
+		probe(config, brain, config.pruning.numProbeGames, &everFired);
+		bool changed = false;
+
+		// Perceptrons of layer idxLayer + 1 read from layer idxLayer, where layer 0 is the input layer
+		int perceptronOffset = 0;
+		for (int idxLayer = 0; idxLayer <= brain.numHiddenLayers; idxLayer++) {
+			const int numOutputs = idxLayer < brain.numHiddenLayers ? brain.hiddenLayerSize : brain.outputLayerSize;
+			for (int idxPerceptron = perceptronOffset; idxPerceptron < perceptronOffset + numOutputs; idxPerceptron++) {
+				const SnakePerceptron* perceptron = brain.perceptrons[idxPerceptron].get();
+				SnakePerceptron* writable = nullptr;
+				for (int idxWeight = 0; idxWeight < perceptron->w.size(); idxWeight++) {
+					// Inputs from a neuron that never fired are 0 in every game we have seen
+					bool isDead = idxLayer > 0 && !everFired[(idxLayer - 1) * brain.hiddenLayerSize + idxWeight];
+					if (perceptron->w[idxWeight] != 0.0f && (isDead || std::abs(perceptron->w[idxWeight]) < config.pruning.weightThreshold)) {
+						// Only copy the perceptron if something changes, so pruning the same brain twice shares it all
+						if (writable == nullptr) {
+							if (!changed) {
+								brain.weightsChanged();
+								changed = true;
+							}
+							writable = brain.mutablePerceptron(idxPerceptron);
+							perceptron = writable;
+						}
+						writable->w[idxWeight] = 0.0f;
+					}
+				}
+			}
+			perceptronOffset += numOutputs;
+		}
+
+		brain.compileSparse();
+
+		stats.numWeights = brain.genomeSize() - static_cast<int>(brain.perceptrons.size());
+		stats.numWeightsKept = brain.sparseBrain()->numWeights();
+		stats.numHidden = numHidden;
+		stats.numHiddenKept = brain.sparseBrain()->numHiddenNeurons();
+
+		return stats;
+	}
+
+	PruneReport pruneAndCompare(const SnakeConfiguration& config, SnakeBrain& brain, SnakeBrain& pruned) {
+		PruneReport report;
+		// Keep the decision caches out of it, they would hide the cost of thinking
+		SnakeBrain dense = brain.clone();
+		dense.setDecisionCache(0);
+		pruned = brain.clone();
+		pruned.setDecisionCache(0);
+
+		report.stats = prune(config, pruned);
+
+		report.fitnessBefore = probe(config, dense, config.pruning.numProbeGames, nullptr);
+		report.fitnessAfter = probe(config, pruned, config.pruning.numProbeGames, nullptr);
+
+		std::vector<std::vector<float>> inputs;
+		for (int i = 0; i < numTimedThinks; i++) {
+			inputs.push_back(getRandomFloats(0.0f, 1.0f, brain.numInputs));
+		}
+		report.thinkNsBefore = timeThink(dense, inputs);
+		report.thinkNsAfter = timeThink(pruned, inputs);
+
+		return report;
+	}
+
+	void printPruneReport(const PruneReport& report) {
+		std::cout << std::format("Pruned brain: {} of {} weights, {} of {} hidden neurons left",
+			report.stats.numWeightsKept, report.stats.numWeights, report.stats.numHiddenKept, report.stats.numHidden) << std::endl;
+		std::cout << std::format("Average fitness {:.1f} -> {:.1f}, {:.0f} -> {:.0f} ns per think ({:.2f}x)",
+			report.fitnessBefore, report.fitnessAfter, report.thinkNsBefore, report.thinkNsAfter,
+			report.thinkNsAfter > 0 ? report.thinkNsBefore / report.thinkNsAfter : 0.0f) << std::endl;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "snake.h"
+#include "config.h"
+
+namespace ClSnake {
+
+	struct PruneStats {
+		int numWeights = 0;
+		int numWeightsKept = 0;
+		int numHidden = 0;
+		int numHiddenKept = 0;
+	};
+
+	// Removes what the brain doesn't need, see SnakeConfiguration::Pruning: plays a few games to find the hidden
+	//	neurons that never fire and zeroes their outgoing weights, zeroes the weights below the threshold and
+	//	compiles the brain to its sparse form
+	PruneStats prune(const SnakeConfiguration& config, SnakeBrain& brain);
+
+	struct PruneReport {
+		PruneStats stats;
+		float fitnessBefore = 0;
+		float fitnessAfter = 0;
+		// Time per think
+		float thinkNsBefore = 0;
+		float thinkNsAfter = 0;
+	};
+
+	// Prunes a copy of brain into pruned, and plays the same games with both to compare them
+	PruneReport pruneAndCompare(const SnakeConfiguration& config, SnakeBrain& brain, SnakeBrain& pruned);
+	void printPruneReport(const PruneReport& report);
+}
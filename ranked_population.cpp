@@ -0,0 +1,102 @@
+#include <algorithm>
+
+#include "ranked_population.h"
+
+namespace ClSnake {
+
+	RankedPopulation::RankedPopulation(int tCapacity) {
+		capacity = tCapacity;
+		members.reserve(capacity + 1);
+	}
+
+	bool RankedPopulation::insert(SnakeBrain brain, int fitness) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (members.size() >= capacity && fitness <= members.back().fitness) {
+			return false;
+		}
+
+		place(Member{ fitness, fitness, 1, std::make_shared<SnakeBrain>(std::move(brain)) });
+
+		if (members.size() > capacity) {
+			members.pop_back();
+		}
+
+		return true;
+	}
+
+	void RankedPopulation::place(Member member) {
+		// After any existing members with the same fitness, so the older ones are kept first
+		auto iter = std::upper_bound(members.begin(), members.end(), member.fitness, [](int f, const Member& m) {return f > m.fitness; });
+		members.insert(iter, std::move(member));
+	}
+
+	int RankedPopulation::parentCount(float partOfParents) {
+		return std::min(static_cast<int>(members.size()), std::max(2, static_cast<int>(capacity * partOfParents)));
+	}
+
+	bool RankedPopulation::pickForReevaluation(float partOfParents, std::shared_ptr<SnakeBrain>& brain) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (members.empty()) {
+			return false;
+		}
+
+		// Ties go to the better member, since that's the one most likely to be picked as a parent
+		auto last = members.begin() + parentCount(partOfParents);
+		auto iter = std::min_element(members.begin(), last, [](const Member& a, const Member& b) {return a.numEvaluations < b.numEvaluations; });
+		brain = iter->brain;
+
+		return true;
+	}
+
+	void RankedPopulation::addEvaluation(const std::shared_ptr<SnakeBrain>& brain, int fitness) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto iter = std::find_if(members.begin(), members.end(), [&brain](const Member& m) {return m.brain == brain; });
+		if (iter == members.end()) {
+			return;
+		}
+
+		Member member = std::move(*iter);
+		members.erase(iter);
+		member.fitnessSum += fitness;
+		member.numEvaluations++;
+		member.fitness = static_cast<int>(member.fitnessSum / member.numEvaluations);
+		place(std::move(member));
+	}
+
+	bool RankedPopulation::pickParents(float partOfParents, std::shared_ptr<SnakeBrain>& parent1, std::shared_ptr<SnakeBrain>& parent2) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		const int numParents = parentCount(partOfParents);
+
+		if (numParents < 2) {
+			return false;
+		}
+
+		auto parentIdx1 = 0;
+		auto parentIdx2 = 0;
+		// Make sure the parents are two different individuals
+		while (parentIdx1 == parentIdx2) {
+			parentIdx1 = getRandomInt(0, numParents - 1);
+			parentIdx2 = getRandomInt(0, numParents - 1);
+		}
+
+		parent1 = members[parentIdx1].brain;
+		parent2 = members[parentIdx2].brain;
+
+		return true;
+	}
+
+	int RankedPopulation::size() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return static_cast<int>(members.size());
+	}
+
+	SnakeBrain RankedPopulation::best(int& fitness) {
+		std::lock_guard<std::mutex> lock(mutex);
+		fitness = members.front().fitness;
+		return members.front().brain->clone();
+	}
+}
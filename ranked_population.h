@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+
+#include "snake.h"
+
+namespace ClSnake {
+
+	// Population sorted on fitness, best first, that several threads can insert into and breed from at the same time.
+	//	Once full, a new brain only gets in by pushing out the worst one. The fitness of a member is the mean over the
+	//	games it has played, so a brain that was lucky once drops when it's evaluated again
+	class RankedPopulation {
+	public:
+		RankedPopulation(int tCapacity);
+
+		// Returns false if the brain wasn't good enough to get in
+		bool insert(SnakeBrain brain, int fitness);
+		// Picks two different parents among the best part of the population (partOfParents on range 0 - 1).
+		//	Returns false when there are fewer than two brains to pick from
+		bool pickParents(float partOfParents, std::shared_ptr<SnakeBrain>& parent1, std::shared_ptr<SnakeBrain>& parent2);
+		// Picks the parent that has played the fewest games, to play another one. Returns false when empty
+		bool pickForReevaluation(float partOfParents, std::shared_ptr<SnakeBrain>& brain);
+		// Adds the fitness of one more game played by brain. Ignored if brain was pushed out meanwhile
+		void addEvaluation(const std::shared_ptr<SnakeBrain>& brain, int fitness);
+		int size();
+		// Only valid when size() > 0
+		SnakeBrain best(int& fitness);
+	private:
+		struct Member {
+			// Mean of the games played
+			int fitness;
+			long long fitnessSum;
+			int numEvaluations;
+			// Shared, so a parent stays alive while a child is made from it, even if it is pushed out meanwhile
+			std::shared_ptr<SnakeBrain> brain;
+		};
+
+		int capacity;
+		std::vector<Member> members;
+		std::mutex mutex;
+
+		int parentCount(float partOfParents);
+		// Inserts member at its place in the ranking. Must hold mutex
+		void place(Member member);
+	};
+}
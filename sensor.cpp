@@ -0,0 +1,462 @@
+#include <bit>
+#include <algorithm>
+#include <array>
+
+#include "sensor.h"
+
+void MeasureSquares::clear() {
+	body.clear();
+	food.clear();
+	wall.clear();
+}
+
+bool encodeMeasurements(std::span<const float> measurements, uint64_t& key) {
+	if (measurements.size() != 24) {
+		return false;
+	}
+
+	key = 0;
+
+	for (int idxDir = 0; idxDir < 8; idxDir++) {
+		float wall = measurements[idxDir * 3 + 0];
+		float food = measurements[idxDir * 3 + 1];
+		float body = measurements[idxDir * 3 + 2];
+		// Wall is 1 / distance, so make sure we get exactly the same value back from the distance
+		int distance = static_cast<int>(1.0f / wall + 0.5f);
+		if (distance < 1 || distance > 64 || 1.0f / distance != wall) {
+			return false;
+		}
+		if ((food != 0.0f && food != 1.0f) || (body != 0.0f && body != 1.0f)) {
+			return false;
+		}
+		uint64_t bits = static_cast<uint64_t>(distance - 1) | (food != 0.0f ? 1ull << 6 : 0) | (body != 0.0f ? 1ull << 7 : 0);
+		key |= bits << (idxDir * 8);
+	}
+
+	return true;
+}
+
+namespace {
+
+	// Bits strictly above / below bit idx
+	uint64_t bitsAbove(int idx) {
+		return (idx >= 63) ? 0 : (~0ull << (idx + 1));
+	}
+
+	uint64_t bitsBelow(int idx) {
+		return (1ull << idx) - 1;
+	}
+
+	// Steps from pos in direction delta until we leave the board, along one axis
+	int stepsToLeave(int pos, int delta, int size) {
+		if (delta > 0) {
+			return size - pos;
+		}
+		if (delta < 0) {
+			return pos + 1;
+		}
+		return Sensor::maxBoardSize + 1;
+	}
+}
+
+Sensor::Sensor(int tBoardWidth, int tBoardHeight, std::pmr::memory_resource* resource) : cellCount(resource) {
+	boardWidth = tBoardWidth;
+	boardHeight = tBoardHeight;
+}
+
+void Sensor::reset(const Snake* snake) {
+	cellCount.assign(boardWidth * boardHeight, 0);
+	clearBody();
+
+	for (auto& bp : snake->body) {
+		addBody(bp);
+	}
+}
+
+void Sensor::addBody(Vec2i pt) {
+	// The head can be outside the board when the snake just crashed
+	if (pt.x < 0 || pt.x >= boardWidth || pt.y < 0 || pt.y >= boardHeight) {
+		return;
+	}
+
+	if (cellCount[pt.y * boardWidth + pt.x]++ == 0) {
+		setBody(pt, true);
+	}
+}
+
+void Sensor::removeBody(Vec2i pt) {
+	if (pt.x < 0 || pt.x >= boardWidth || pt.y < 0 || pt.y >= boardHeight) {
+		return;
+	}
+
+	if (--cellCount[pt.y * boardWidth + pt.x] == 0) {
+		setBody(pt, false);
+	}
+}
+
+bool Sensor::isBody(Vec2i pt) {
+	return cellCount[pt.y * boardWidth + pt.x] > 0;
+}
+
+RaySensor::RaySensor(int tBoardWidth, int tBoardHeight, std::pmr::memory_resource* resource)
+	: Sensor(tBoardWidth, tBoardHeight, resource), rows(resource), columns(resource), diagonals(resource), antiDiagonals(resource) {
+}
+
+int RaySensor::numInputs() const {
+	return numMeasurements;
+}
+
+void RaySensor::clearBody() {
+	rows.assign(boardHeight, 0);
+	columns.assign(boardWidth, 0);
+	diagonals.assign(boardWidth + boardHeight - 1, 0);
+	antiDiagonals.assign(boardWidth + boardHeight - 1, 0);
+}
+
+void RaySensor::setBody(Vec2i pt, bool value) {
+	uint64_t xBit = 1ull << pt.x;
+	uint64_t yBit = 1ull << pt.y;
+
+	if (value) {
+		rows[pt.y] |= xBit;
+		columns[pt.x] |= yBit;
+		diagonals[pt.x - pt.y + boardHeight - 1] |= xBit;
+		antiDiagonals[pt.x + pt.y] |= xBit;
+	}
+	else {
+		rows[pt.y] &= ~xBit;
+		columns[pt.x] &= ~yBit;
+		diagonals[pt.x - pt.y + boardHeight - 1] &= ~xBit;
+		antiDiagonals[pt.x + pt.y] &= ~xBit;
+	}
+}
+
+void RaySensor::measure(const Snake* snake, Vec2i foodPosition, std::pmr::vector<float>& measurements, MeasureSquares* measureSquares) {
+	// Same order and rotation as Game::measure
+	static const Vec2i posDeltas[] = {
+		Vec2i(-1, 1),
+		Vec2i(-1, 0),
+		Vec2i(-1, -1),
+		Vec2i(0,  -1),
+		Vec2i(1,  -1),
+		Vec2i(1,  0),
+		Vec2i(1,  1),
+		Vec2i(0,  1)
+	};
+
+	int indexOffset = 0;
+
+	switch (snake->direction) {
+	case SnakeDirection::Up:	indexOffset = 0; break;
+	case SnakeDirection::Right:	indexOffset = 2; break;
+	case SnakeDirection::Down:	indexOffset = 4; break;
+	case SnakeDirection::Left:	indexOffset = 6; break;
+	}
+
+	const int x = snake->position.x;
+	const int y = snake->position.y;
+
+	measurements.assign(numMeasurements, 0);
+
+	for (int idxDir = 0; idxDir < 8; idxDir++) {
+		Vec2i deltaPos = posDeltas[(idxDir + indexOffset) % 8];
+		int dx = deltaPos.x;
+		int dy = deltaPos.y;
+
+		// Same as counting the squares until the wall, plus one
+		int distance = std::min(stepsToLeave(x, dx, boardWidth), stepsToLeave(y, dy, boardHeight));
+
+		// Food is on the ray if it's a positive multiple of the delta away
+		int fx = foodPosition.x - x;
+		int fy = foodPosition.y - y;
+		bool foodOnRay = (dx == 0 ? fx == 0 : (fx * dx > 0)) && (dy == 0 ? fy == 0 : (fy * dy > 0)) && (dx == 0 || dy == 0 || fx * dy == fy * dx);
+
+		// Body parts on the ray, as bits in the mask of the line through the head. For all lines but the columns,
+		//	bit index is x, so moving along the ray means moving up (dx > 0) or down (dx < 0) in bits
+		uint64_t lineBits = 0;
+		int bitIdx = 0;
+		int stepSign = 0;
+		if (dy == 0) {
+			lineBits = rows[y];
+			bitIdx = x;
+			stepSign = dx;
+		}
+		else if (dx == 0) {
+			lineBits = columns[x];
+			bitIdx = y;
+			stepSign = dy;
+		}
+		else if (dx == dy) {
+			lineBits = diagonals[x - y + boardHeight - 1];
+			bitIdx = x;
+			stepSign = dx;
+		}
+		else {
+			lineBits = antiDiagonals[x + y];
+			bitIdx = x;
+			stepSign = dx;
+		}
+		uint64_t rayBits = lineBits & (stepSign > 0 ? bitsAbove(bitIdx) : bitsBelow(bitIdx));
+
+		if (measureSquares != nullptr) {
+			if (foodOnRay) {
+				measureSquares->food.push_back(foodPosition);
+			}
+			if (rayBits != 0) {
+				// The first body part along the ray is the closest set bit
+				int hitIdx = (stepSign > 0) ? std::countr_zero(rayBits) : 63 - std::countl_zero(rayBits);
+				int numSteps = std::abs(hitIdx - bitIdx);
+				measureSquares->body.push_back(Vec2i(x + dx * numSteps, y + dy * numSteps));
+			}
+			measureSquares->wall.push_back(Vec2i(x + dx * distance, y + dy * distance));
+		}
+
+		// Three values, so multiply by three
+		int idxStart = idxDir * 3;
+		measurements[idxStart + 0] = 1.0f / distance;
+		measurements[idxStart + 1] = foodOnRay ? 1.0f : 0.0f;
+		measurements[idxStart + 2] = (rayBits != 0) ? 1.0f : 0.0f;
+	}
+}
+
+namespace {
+
+	// Ahead and to the right of a snake going in direction, in board coordinates
+	Vec2i forwardOf(SnakeDirection direction) {
+		switch (direction) {
+		case SnakeDirection::Up: return Vec2i(0, -1);
+		case SnakeDirection::Right: return Vec2i(1, 0);
+		case SnakeDirection::Down: return Vec2i(0, 1);
+		case SnakeDirection::Left: return Vec2i(-1, 0);
+		}
+
+		return Vec2i(0, -1);
+	}
+
+	Vec2i rightOf(SnakeDirection direction) {
+		switch (direction) {
+		case SnakeDirection::Up: return Vec2i(1, 0);
+		case SnakeDirection::Right: return Vec2i(0, 1);
+		case SnakeDirection::Down: return Vec2i(-1, 0);
+		case SnakeDirection::Left: return Vec2i(0, -1);
+		}
+
+		return Vec2i(1, 0);
+	}
+
+	// Bits first to first + count - 1
+	uint64_t bitRange(int first, int count) {
+		if (count <= 0) {
+			return 0;
+		}
+		return (count >= 64 ? ~0ull : (1ull << count) - 1) << first;
+	}
+
+	// The bits of a byte as eight floats, lowest bit first
+	std::array<std::array<float, 8>, 256> makeByteToFloats() {
+		std::array<std::array<float, 8>, 256> table{};
+		for (int byte = 0; byte < 256; byte++) {
+			for (int bit = 0; bit < 8; bit++) {
+				table[byte][bit] = static_cast<float>((byte >> bit) & 1);
+			}
+		}
+		return table;
+	}
+
+	const std::array<std::array<float, 8>, 256> byteToFloats = makeByteToFloats();
+}
+
+int WindowSensor::numInputsFor(int windowSize) {
+	return windowSize * windowSize + 2;
+}
+
+WindowSensor::WindowSensor(int tBoardWidth, int tBoardHeight, int tWindowSize, std::pmr::memory_resource* resource)
+	: Sensor(tBoardWidth, tBoardHeight, resource), lines(resource) {
+	windowSize = tWindowSize;
+	margin = windowSize / 2;
+	paddedWidth = boardWidth + 2 * margin;
+	paddedHeight = boardHeight + 2 * margin;
+	useMasks = paddedWidth <= maxBoardSize && paddedHeight <= maxBoardSize;
+	linesPerOrientation = std::max(paddedWidth, paddedHeight);
+}
+
+int WindowSensor::numInputs() const {
+	return numInputsFor(windowSize);
+}
+
+uint64_t* WindowSensor::line(Orientation orientation) {
+	return lines.data() + orientation * linesPerOrientation;
+}
+
+void WindowSensor::clearBody() {
+	if (!useMasks) {
+		return;
+	}
+
+	lines.assign(NumOrientations * linesPerOrientation, 0);
+
+	// The margin is wall. It's the same on both sides, so mirroring doesn't change it
+	uint64_t* rows = line(Rows);
+	uint64_t* columns = line(Columns);
+	for (int y = 0; y < paddedHeight; y++) {
+		bool inMargin = y < margin || y >= margin + boardHeight;
+		rows[y] = inMargin ? bitRange(0, paddedWidth) : bitRange(0, margin) | bitRange(margin + boardWidth, margin);
+	}
+	for (int x = 0; x < paddedWidth; x++) {
+		bool inMargin = x < margin || x >= margin + boardWidth;
+		columns[x] = inMargin ? bitRange(0, paddedHeight) : bitRange(0, margin) | bitRange(margin + boardHeight, margin);
+	}
+	std::copy_n(rows, paddedHeight, line(MirroredRows));
+	std::copy_n(columns, paddedWidth, line(MirroredColumns));
+}
+
+void WindowSensor::setBody(Vec2i pt, bool value) {
+	if (!useMasks) {
+		return;
+	}
+
+	const int px = pt.x + margin;
+	const int py = pt.y + margin;
+	uint64_t& row = line(Rows)[py];
+	uint64_t& column = line(Columns)[px];
+	uint64_t& mirroredRow = line(MirroredRows)[py];
+	uint64_t& mirroredColumn = line(MirroredColumns)[px];
+	uint64_t xBit = 1ull << px;
+	uint64_t yBit = 1ull << py;
+	uint64_t mirroredXBit = 1ull << (paddedWidth - 1 - px);
+	uint64_t mirroredYBit = 1ull << (paddedHeight - 1 - py);
+
+	if (value) {
+		row |= xBit;
+		column |= yBit;
+		mirroredRow |= mirroredXBit;
+		mirroredColumn |= mirroredYBit;
+	}
+	else {
+		row &= ~xBit;
+		column &= ~yBit;
+		mirroredRow &= ~mirroredXBit;
+		mirroredColumn &= ~mirroredYBit;
+	}
+}
+
+Vec2i WindowSensor::windowToBoard(const Snake* snake, int column, int row) {
+	Vec2i forward = forwardOf(snake->direction);
+	Vec2i right = rightOf(snake->direction);
+	int ahead = margin - row;
+	int toRight = column - margin;
+
+	return Vec2i(snake->position.x + forward.x * ahead + right.x * toRight, snake->position.y + forward.y * ahead + right.y * toRight);
+}
+
+void WindowSensor::measureFood(const Snake* snake, Vec2i foodPosition, std::pmr::vector<float>& measurements, MeasureSquares* measureSquares) {
+	Vec2i forward = forwardOf(snake->direction);
+	Vec2i right = rightOf(snake->direction);
+	int fx = foodPosition.x - snake->position.x;
+	int fy = foodPosition.y - snake->position.y;
+	int ahead = fx * forward.x + fy * forward.y;
+	int toRight = fx * right.x + fy * right.y;
+	float boardSize = static_cast<float>(std::max(boardWidth, boardHeight));
+
+	measurements[windowSize * windowSize + 0] = ahead / boardSize;
+	measurements[windowSize * windowSize + 1] = toRight / boardSize;
+
+	if (measureSquares != nullptr && std::abs(ahead) <= margin && std::abs(toRight) <= margin) {
+		measureSquares->food.push_back(foodPosition);
+	}
+}
+
+void WindowSensor::measure(const Snake* snake, Vec2i foodPosition, std::pmr::vector<float>& measurements, MeasureSquares* measureSquares) {
+	if (!useMasks) {
+		measureFull(snake, foodPosition, measurements, measureSquares);
+		return;
+	}
+
+	// Row r of the window is windowSize bits of line firstLine + lineStep * r, starting at bit firstBit.
+	//	In the margin coordinates of lines, the head is at (x + margin, y + margin)
+	const int x = snake->position.x;
+	const int y = snake->position.y;
+	Orientation orientation = Rows;
+	int firstLine = 0;
+	int lineStep = 1;
+	int firstBit = 0;
+
+	switch (snake->direction) {
+	case SnakeDirection::Up:
+		orientation = Rows;
+		firstLine = y;
+		lineStep = 1;
+		firstBit = x;
+		break;
+	case SnakeDirection::Right:
+		orientation = Columns;
+		firstLine = x + 2 * margin;
+		lineStep = -1;
+		firstBit = y;
+		break;
+	case SnakeDirection::Down:
+		orientation = MirroredRows;
+		firstLine = y + 2 * margin;
+		lineStep = -1;
+		firstBit = paddedWidth - 1 - x - 2 * margin;
+		break;
+	case SnakeDirection::Left:
+		orientation = MirroredColumns;
+		firstLine = x;
+		lineStep = 1;
+		firstBit = paddedHeight - 1 - y - 2 * margin;
+		break;
+	}
+
+	const uint64_t windowMask = bitRange(0, windowSize);
+	const uint64_t* orientationLines = line(orientation);
+
+	// Rows are written eight floats at a time, so leave room for the last one to spill over
+	measurements.resize(windowSize * windowSize + 8);
+	float* out = measurements.data();
+
+	for (int row = 0; row < windowSize; row++) {
+		uint64_t bits = (orientationLines[firstLine + lineStep * row] >> firstBit) & windowMask;
+
+		for (int column = 0; column < windowSize; column += 8) {
+			const float* values = byteToFloats[(bits >> column) & 0xff].data();
+			for (int i = 0; i < 8; i++) {
+				out[column + i] = values[i];
+			}
+		}
+		out += windowSize;
+
+		if (measureSquares != nullptr) {
+			for (int column = 0; column < windowSize; column++) {
+				if ((bits >> column) & 1) {
+					Vec2i pt = windowToBoard(snake, column, row);
+					bool wall = pt.x < 0 || pt.x >= boardWidth || pt.y < 0 || pt.y >= boardHeight;
+					(wall ? measureSquares->wall : measureSquares->body).push_back(pt);
+				}
+			}
+		}
+	}
+
+	measurements.resize(numInputs());
+	measureFood(snake, foodPosition, measurements, measureSquares);
+}
+
+void WindowSensor::measureFull(const Snake* snake, Vec2i foodPosition, std::pmr::vector<float>& measurements, MeasureSquares* measureSquares) {
+	measurements.assign(numInputs(), 0);
+
+	for (int row = 0; row < windowSize; row++) {
+		for (int column = 0; column < windowSize; column++) {
+			Vec2i pt = windowToBoard(snake, column, row);
+			bool wall = pt.x < 0 || pt.x >= boardWidth || pt.y < 0 || pt.y >= boardHeight;
+			bool body = !wall && isBody(pt);
+
+			measurements[row * windowSize + column] = (wall || body) ? 1.0f : 0.0f;
+
+			if (measureSquares != nullptr && (wall || body)) {
+				(wall ? measureSquares->wall : measureSquares->body).push_back(pt);
+			}
+		}
+	}
+
+	measureFood(snake, foodPosition, measurements, measureSquares);
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <memory_resource>
+#include <span>
+
+#include "snake.h"
+
+// Squares the snake "sees", for rendering
+struct MeasureSquares {
+	std::vector<Vec2i> body;
+	std::vector<Vec2i> food;
+	std::vector<Vec2i> wall;
+
+	void clear();
+};
+
+// Packs the 24 measurements of Game::measure into a key that is unique for each possible set of measurements:
+//	8 bits per direction, 6 for the distance to the wall and one each for food and body. Returns false for
+//	measurements that can't be encoded exactly, eg. from a board larger than 64 x 64
+bool encodeMeasurements(std::span<const float> measurements, uint64_t& key);
+
+// Measures what the snake sees before each move. Keeps track of the body as the snake moves, so a measurement
+//	doesn't have to look through the whole body
+class Sensor {
+public:
+	// Largest board where the body fits in one 64 bit mask per line
+	static const int maxBoardSize = 64;
+
+	Sensor(int tBoardWidth, int tBoardHeight, std::pmr::memory_resource* resource);
+	virtual ~Sensor() = default;
+
+	// Number of measurements written by measure()
+	virtual int numInputs() const = 0;
+	// Rebuild from the body of the snake
+	void reset(const Snake* snake);
+	void addBody(Vec2i pt);
+	void removeBody(Vec2i pt);
+	bool isBody(Vec2i pt);
+	// Writes numInputs() measurements
+	virtual void measure(const Snake* snake, Vec2i foodPosition, std::pmr::vector<float>& measurements, MeasureSquares* measureSquares) = 0;
+protected:
+	int boardWidth;
+	int boardHeight;
+
+	// Called when pt becomes part of the body, or stops being part of it
+	virtual void setBody(Vec2i pt, bool value) = 0;
+	// Called by reset() before the body is added. Also where a sensor sets itself up for the board
+	virtual void clearBody() = 0;
+private:
+	// Number of body parts on each cell. Only ever 0 or 1 while the snake is alive
+	std::pmr::vector<uint8_t> cellCount;
+};
+
+// Incremental version of the ray measurements in Game::measure, with exactly the same output.
+//
+// Instead of walking each ray and checking every body part on the way, the body is kept as bit masks: one per row,
+//	column, diagonal and anti-diagonal. Whether a ray hits the body is then a single mask test, and the distance
+//	to the wall and the food follow from the coordinates. When the snake moves, only the lines through the new head
+//	and the old tail are updated, so the cost per step doesn't depend on the length of the snake.
+//
+// Works for boards up to 64 x 64.
+class RaySensor : public Sensor {
+public:
+	static const int numMeasurements = 24;
+
+	RaySensor(int tBoardWidth, int tBoardHeight, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+	int numInputs() const override;
+	// Writes 24 measurements, see Game::measure
+	void measure(const Snake* snake, Vec2i foodPosition, std::pmr::vector<float>& measurements, MeasureSquares* measureSquares) override;
+protected:
+	void setBody(Vec2i pt, bool value) override;
+	void clearBody() override;
+private:
+	// Bit x of rows[y] is set if (x, y) is part of the body
+	std::pmr::vector<uint64_t> rows;
+	// Bit y of columns[x]
+	std::pmr::vector<uint64_t> columns;
+	// Bit x of diagonals[x - y + boardHeight - 1]
+	std::pmr::vector<uint64_t> diagonals;
+	// Bit x of antiDiagonals[x + y]
+	std::pmr::vector<uint64_t> antiDiagonals;
+};
+
+// What the snake sees of the windowSize x windowSize squares around its head, turned so the snake looks up:
+//	row 0 is the farthest ahead and column 0 the farthest to the left. One value per square, row by row: 1 if it's
+//	occupied (body, or wall outside the board), otherwise 0. Then two values for where the food is, relative to the
+//	direction of the snake: squares ahead and squares to the right, divided by the board size.
+//
+// The occupancy is kept as bit masks of the board plus a margin of windowSize / 2 wall squares around it, in four
+//	orientations: rows, columns, and both mirrored. For each direction of the snake there is one orientation where
+//	a row of the window is a run of bits in one line, so the window is cut out with one shift and mask per row.
+//	Moving the snake updates one bit in each orientation.
+//
+// The board and its margin must fit in 64 x 64. On larger boards the squares are looked up one by one instead.
+class WindowSensor : public Sensor {
+public:
+	static int numInputsFor(int windowSize);
+
+	// windowSize should be odd, so the head is in the middle. Nothing is allocated until reset()
+	WindowSensor(int tBoardWidth, int tBoardHeight, int tWindowSize, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+	int numInputs() const override;
+	void measure(const Snake* snake, Vec2i foodPosition, std::pmr::vector<float>& measurements, MeasureSquares* measureSquares) override;
+	// Same as measure(), one square at a time. Used when the board is too large for the masks
+	void measureFull(const Snake* snake, Vec2i foodPosition, std::pmr::vector<float>& measurements, MeasureSquares* measureSquares);
+protected:
+	void setBody(Vec2i pt, bool value) override;
+	void clearBody() override;
+private:
+	enum Orientation {
+		Rows,
+		Columns,
+		MirroredRows,
+		MirroredColumns,
+		NumOrientations
+	};
+
+	int windowSize;
+	// Wall squares around the board, windowSize / 2
+	int margin;
+	bool useMasks;
+	// Size of the board including the margin
+	int paddedWidth;
+	int paddedHeight;
+	// Lines of each orientation, see line(). Bit i of line j in Rows is square (i - margin, j - margin); the other
+	//	orientations are the same with x and y swapped and/or the bits reversed
+	std::pmr::vector<uint64_t> lines;
+	int linesPerOrientation;
+
+	uint64_t* line(Orientation orientation);
+	// Board square of square (column, row) in the window
+	Vec2i windowToBoard(const Snake* snake, int column, int row);
+	void measureFood(const Snake* snake, Vec2i foodPosition, std::pmr::vector<float>& measurements, MeasureSquares* measureSquares);
+};
@@ -1,6 +1,14 @@
 #include <iostream>
+#include <fstream>
 #include <algorithm>
+#include <atomic>
 #include "snake.h"
+#include "sensor.h"
+#include "decision_cache.h"
+#include "sparse_brain.h"
+#include "blocked_brain.h"
+#include "genome_file.h"
+#include "trace.h"
 
 float sigmoid(float v) {
 	return 1.0f / (1 + std::exp(-v));
@@ -29,59 +37,75 @@ SnakePerceptron SnakePerceptron::clone() {
 }
 
 
-SnakeBrain::SnakeBrain(int tNumInputs, int tNumHiddenLayers, int tHiddenLayerSize, int tOutputLayerSize) {
-	init(tNumInputs, tNumHiddenLayers, tHiddenLayerSize, tOutputLayerSize);
+ThinkBuffers::ThinkBuffers(std::pmr::memory_resource* resource) : current(resource), next(resource), hidden(resource) {
 }
 
-SnakeBrain::SnakeBrain(std::vector<SnakePerceptron> tPerceptrons, int tNumInputs, int tNumHiddenLayers, int tHiddenLayerSize, int tOutputLayerSize) {
+SnakeBrain::SnakeBrain(int tNumInputs, int tNumHiddenLayers, int tHiddenLayerSize, int tOutputLayerSize) {
 	init(tNumInputs, tNumHiddenLayers, tHiddenLayerSize, tOutputLayerSize);
+}
 
-	perceptrons.clear();
+SnakeBrain::SnakeBrain(std::vector<std::shared_ptr<const SnakePerceptron>> tPerceptrons, int tNumInputs, int tNumHiddenLayers, int tHiddenLayerSize, int tOutputLayerSize) {
+	initLayers(tNumInputs, tNumHiddenLayers, tHiddenLayerSize, tOutputLayerSize);
 
-	for (auto& p : tPerceptrons) {
-		perceptrons.push_back(p.clone());
-	}
+	perceptrons = std::move(tPerceptrons);
 }
 
-void SnakeBrain::init(int tNumInputs, int tNumHiddenLayers, int tHiddenLayerSize, int tOutputLayerSize) {
+void SnakeBrain::initLayers(int tNumInputs, int tNumHiddenLayers, int tHiddenLayerSize, int tOutputLayerSize) {
 	numInputs = tNumInputs;
 	numHiddenLayers = tNumHiddenLayers;
 	hiddenLayerSize = tHiddenLayerSize;
 	outputLayerSize = tOutputLayerSize;
 
+	layerSizes.clear();
 	layerSizes.push_back(numInputs);
 	for (int i = 0; i < tNumHiddenLayers; i++) {
 		layerSizes.push_back(hiddenLayerSize);
 	}
 	layerSizes.push_back(outputLayerSize);
+}
+
+void SnakeBrain::init(int tNumInputs, int tNumHiddenLayers, int tHiddenLayerSize, int tOutputLayerSize) {
+	initLayers(tNumInputs, tNumHiddenLayers, tHiddenLayerSize, tOutputLayerSize);
 
 	perceptrons.clear();
 
 	// Includes the output layer. Remember, there are no perceptrons going into the first layer (= input layer)
 	for (int idxLayerSize = 0; idxLayerSize < layerSizes.size() - 1; idxLayerSize++) {
-		std::vector<SnakePerceptron> newPerceptrons;
 		for (int idxPerceptron = 0; idxPerceptron < layerSizes[idxLayerSize + 1]; idxPerceptron++) {
-			newPerceptrons.push_back(SnakePerceptron(layerSizes[idxLayerSize]));
+			perceptrons.push_back(std::make_shared<SnakePerceptron>(layerSizes[idxLayerSize]));
 		}
-		perceptrons.insert(perceptrons.end(), newPerceptrons.begin(), newPerceptrons.end());
 	}
 }
 
 std::vector<float> SnakeBrain::think(const std::vector<float>& inputs) {
-	int perceptronOffsetIn = 0;
-	int perceptronOffsetOut = 0;
+	ThinkBuffers buffers;
+	auto outputs = think(std::span<const float>(inputs), buffers);
+
+	return std::vector<float>(outputs.begin(), outputs.end());
+}
 
-	std::vector<float> activations;
-	for (auto& i : inputs) {
-		activations.push_back(i);
+std::span<const float> SnakeBrain::think(std::span<const float> inputs, ThinkBuffers& buffers) {
+	if (sparse != nullptr) {
+		return sparse->think(inputs, buffers);
+	}
+	if (blocked != nullptr) {
+		return blocked->think(inputs, buffers);
+	}
+
+	auto& activations = buffers.current;
+	auto& newActivations = buffers.next;
+
+	activations.assign(inputs.begin(), inputs.end());
+	if (buffers.keepHidden) {
+		buffers.hidden.clear();
 	}
 
 	int perceptronOffset = 0;
 	for (int idxLayerSize = 1; idxLayerSize < layerSizes.size(); idxLayerSize++) {
-		std::vector<float> newActivations;
+		newActivations.clear();
 		for (int idxPerceptron = perceptronOffset; idxPerceptron < perceptronOffset + layerSizes[idxLayerSize]; idxPerceptron++) {
 			float activation = 0;
-			SnakePerceptron* perceptron = &perceptrons[idxPerceptron];
+			const SnakePerceptron* perceptron = perceptrons[idxPerceptron].get();
 			for (int idxActivation = 0; idxActivation < activations.size(); idxActivation++) {
 				activation += activations[idxActivation] * perceptron->w[idxActivation];
 			}
@@ -89,14 +113,149 @@ std::vector<float> SnakeBrain::think(const std::vector<float>& inputs) {
 			newActivations.push_back(activation);
 		}
 		perceptronOffset += layerSizes[idxLayerSize];
-		activations = newActivations;
+		if (buffers.keepHidden && idxLayerSize < layerSizes.size() - 1) {
+			buffers.hidden.insert(buffers.hidden.end(), newActivations.begin(), newActivations.end());
+		}
+		activations.swap(newActivations);
 	}
 
 	return activations;
 }
 
 SnakeBrain SnakeBrain::clone() {
-	return SnakeBrain(perceptrons, numInputs, numHiddenLayers, hiddenLayerSize, outputLayerSize);
+	SnakeBrain ret(perceptrons, numInputs, numHiddenLayers, hiddenLayerSize, outputLayerSize);
+
+	ret.sparse = sparse;
+	ret.blocked = blocked;
+	ret.expectedSteps = expectedSteps;
+
+	return ret;
+}
+
+void SnakeBrain::weightsChanged() {
+	// The remembered decisions are no longer valid. Leave a shared cache to the other brains
+	if (cache != nullptr) {
+		if (cache.use_count() > 1) {
+			cache = std::make_shared<DecisionCache>(cache->capacity());
+		}
+		else {
+			cache->clear();
+		}
+	}
+	sparse = nullptr;
+	blocked = nullptr;
+}
+
+SnakePerceptron* SnakeBrain::mutablePerceptron(int idx) {
+	auto& perceptron = perceptrons[idx];
+
+	if (perceptron.use_count() == 1) {
+		// We are the only owner. The fence pairs with the release when another brain let go of it,
+		//	so its last reads are done before we write
+		std::atomic_thread_fence(std::memory_order_acquire);
+	}
+	else {
+		perceptron = std::make_shared<SnakePerceptron>(*perceptron);
+	}
+
+	// Perceptrons are always created non-const, and only this brain can reach it now
+	return const_cast<SnakePerceptron*>(perceptron.get());
+}
+
+void SnakeBrain::setDecisionCache(int capacity) {
+	if (capacity <= 0) {
+		cache = nullptr;
+	}
+	else if (cache == nullptr || cache->capacity() != DecisionCache(capacity).capacity()) {
+		cache = std::make_shared<DecisionCache>(capacity);
+	}
+}
+
+DecisionCache* SnakeBrain::decisionCache() {
+	return cache.get();
+}
+
+void SnakeBrain::compileSparse() {
+	sparse = std::make_shared<SparseBrain>(*this);
+}
+
+const SparseBrain* SnakeBrain::sparseBrain() {
+	return sparse.get();
+}
+
+void SnakeBrain::compileBlocked() {
+	blocked = std::make_shared<BlockedBrain>(*this);
+}
+
+const BlockedBrain* SnakeBrain::blockedBrain() {
+	return blocked.get();
+}
+
+std::vector<float> SnakeBrain::toGenome() {
+	std::vector<float> genome;
+	genome.reserve(genomeSize());
+
+	for (auto& p : perceptrons) {
+		genome.insert(genome.end(), p->w.begin(), p->w.end());
+		genome.push_back(p->b);
+	}
+
+	return genome;
+}
+
+void SnakeBrain::toGenome(std::span<float> genome) {
+	int idxGene = 0;
+
+	for (auto& p : perceptrons) {
+		std::copy(p->w.begin(), p->w.end(), genome.begin() + idxGene);
+		idxGene += static_cast<int>(p->w.size());
+		genome[idxGene++] = p->b;
+	}
+}
+
+void SnakeBrain::setGenome(std::span<const float> genome) {
+	int idxGene = 0;
+
+	weightsChanged();
+	for (int idxPerceptron = 0; idxPerceptron < perceptrons.size(); idxPerceptron++) {
+		SnakePerceptron* p = mutablePerceptron(idxPerceptron);
+		for (auto& w : p->w) {
+			w = genome[idxGene++];
+		}
+		p->b = genome[idxGene++];
+	}
+}
+
+int SnakeBrain::genomeSize() {
+	int size = 0;
+
+	for (auto& p : perceptrons) {
+		size += static_cast<int>(p->w.size()) + 1;
+	}
+
+	return size;
+}
+
+bool SnakeBrain::save(const std::string& path) {
+	std::ofstream out(path, std::ios::binary);
+
+	if (!out) {
+		return false;
+	}
+
+	auto genome = toGenome();
+
+	GenomeFileHeader header;
+	header.numInputs = numInputs;
+	header.numHiddenLayers = numHiddenLayers;
+	header.hiddenLayerSize = hiddenLayerSize;
+	header.outputLayerSize = outputLayerSize;
+	header.genomeSize = static_cast<int32_t>(genome.size());
+
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(genome.data()), genome.size() * sizeof(float));
+
+	return static_cast<bool>(out);
 }
 
 std::vector<float> SnakeBrain::processLayer(std::vector<float> inActivations, std::vector<float> weights, float (*activationFunction)(float)) {
@@ -124,7 +283,7 @@ int SnakeBrain::layerIdToPerceptronId(int layerIdx, int localIdx) {
 	return ret;
 }
 
-Snake::Snake(SnakeBrain* tSnakeBrain, Vec2i tPos) {
+Snake::Snake(SnakeBrain* tSnakeBrain, Vec2i tPos, std::pmr::memory_resource* resource) : body(resource), thinkBuffers(resource) {
 	position = tPos;
 	direction = SnakeDirection::Down;
 	body.push_back(tPos + Vec2i(0, -2));
@@ -135,12 +294,21 @@ Snake::Snake(SnakeBrain* tSnakeBrain, Vec2i tPos) {
 	snakeBrain = tSnakeBrain;
 }
 
-SnakeMove Snake::think(std::vector<float> input) {
-	auto outputs = snakeBrain->think(input);
-	auto maxElementIndex = std::distance(std::begin(outputs), std::max_element(std::begin(outputs), std::end(outputs)));
-
+SnakeMove Snake::think(std::span<const float> input) {
+	TRACE_SAMPLED_SCOPE("Snake::think");
+	DecisionCache* cache = snakeBrain->decisionCache();
+	uint64_t key = 0;
+	// A cached move has no hidden activations to keep
+	bool useCache = cache != nullptr && !thinkBuffers.keepHidden && encodeMeasurements(input, key);
 	SnakeMove dir = SnakeMove::Forward;
 
+	if (useCache && cache->find(key, dir)) {
+		return dir;
+	}
+
+	auto outputs = snakeBrain->think(input, thinkBuffers);
+	auto maxElementIndex = std::distance(std::begin(outputs), std::max_element(std::begin(outputs), std::end(outputs)));
+
 	// Order here doesn't matter; as long as the order is always the same,
 	//	the brain will evolve accordingly
 	switch (maxElementIndex) {
@@ -150,48 +318,58 @@ SnakeMove Snake::think(std::vector<float> input) {
 	default: std::cout << "maxElementIndex out of bounds: " << maxElementIndex << std::endl;
 	}
 
+	if (useCache) {
+		cache->insert(key, dir);
+	}
+
 	return dir;
 }
 
+void Snake::setKeepHidden(bool keepHidden) {
+	thinkBuffers.keepHidden = keepHidden;
+}
+
+std::span<const float> Snake::hiddenActivations() {
+	return thinkBuffers.hidden;
+}
+
 void Snake::updateDirection(SnakeMove move) {
 	if (move == SnakeMove::Forward) {
 		return;
 	}
 
-	std::map<SnakeDirection, SnakeDirection> leftMove = {
-		{ SnakeDirection::Down, SnakeDirection::Right},
-		{ SnakeDirection::Left, SnakeDirection::Down},
-		{ SnakeDirection::Right, SnakeDirection::Up},
-		{ SnakeDirection::Up, SnakeDirection::Left},
-	};
-
-	std::map<SnakeDirection, SnakeDirection> rightMove = {
-		{ SnakeDirection::Down, SnakeDirection::Left},
-		{ SnakeDirection::Left, SnakeDirection::Up},
-		{ SnakeDirection::Right, SnakeDirection::Down},
-		{ SnakeDirection::Up, SnakeDirection::Right},
-	};
-
+	// Switches rather than maps, since this runs for every step
 	if (move == SnakeMove::Left) {
-		direction = leftMove[direction];
+		switch (direction) {
+		case SnakeDirection::Down: direction = SnakeDirection::Right; break;
+		case SnakeDirection::Left: direction = SnakeDirection::Down; break;
+		case SnakeDirection::Right: direction = SnakeDirection::Up; break;
+		case SnakeDirection::Up: direction = SnakeDirection::Left; break;
+		}
 	}
 	else {
-		direction = rightMove[direction];
+		switch (direction) {
+		case SnakeDirection::Down: direction = SnakeDirection::Left; break;
+		case SnakeDirection::Left: direction = SnakeDirection::Up; break;
+		case SnakeDirection::Right: direction = SnakeDirection::Down; break;
+		case SnakeDirection::Up: direction = SnakeDirection::Right; break;
+		}
 	}
 }
 
 Vec2i Snake::nextPosition() {
-	std::map<SnakeDirection, Vec2i> pDeltaMap = {
-		{SnakeDirection::Down, Vec2i(0,1)},
-		{SnakeDirection::Left,Vec2i(-1,0)},
-		{SnakeDirection::Right, Vec2i(1,0)},
-		{SnakeDirection::Up, Vec2i(0,-1)}
-	};
+	switch (direction) {
+	case SnakeDirection::Down: return position + Vec2i(0, 1);
+	case SnakeDirection::Left: return position + Vec2i(-1, 0);
+	case SnakeDirection::Right: return position + Vec2i(1, 0);
+	case SnakeDirection::Up: return position + Vec2i(0, -1);
+	}
 
-	return position + pDeltaMap[direction];
+	return position;
 }
 
 void Snake::move() {
+	TRACE_SAMPLED_SCOPE("Snake::move");
 	position = nextPosition();
 
 	body.push_back(position);
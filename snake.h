@@ -2,6 +2,9 @@
 
 #include <vector>
 #include <ctime>
+#include <span>
+#include <memory>
+#include <memory_resource>
 
 #include "utils.h"
 #include <map>
@@ -31,36 +34,101 @@ struct SnakePerceptron {
 	SnakePerceptron clone();
 };
 
+// Scratch space for SnakeBrain::think, so playing a game doesn't allocate for every step
+struct ThinkBuffers {
+	std::pmr::vector<float> current;
+	std::pmr::vector<float> next;
+	// When set, think() also stores the activations of all hidden layers in hidden, first layer first
+	bool keepHidden = false;
+	std::pmr::vector<float> hidden;
+
+	ThinkBuffers(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+};
+
+class DecisionCache;
+class SparseBrain;
+class BlockedBrain;
+
+// Perceptrons are immutable blocks shared between brains, so copying a brain (or making a child that takes most
+//	perceptrons from its parents) doesn't copy any weights. A perceptron is only copied when a brain that shares it
+//	changes it, see mutablePerceptron()
 class SnakeBrain {
 public:
 	SnakeBrain(int tNumInputs, int tNumHiddenLayers, int tHiddenLayerSize, int tOutputLayerSize);
-	SnakeBrain(std::vector<SnakePerceptron> tPerceptrons, int tNumInputs, int tNumHiddenLayers, int tHiddenLayerSize, int tOutputLayerSize);
-	std::vector<SnakePerceptron> perceptrons;
+	// Shares tPerceptrons
+	SnakeBrain(std::vector<std::shared_ptr<const SnakePerceptron>> tPerceptrons, int tNumInputs, int tNumHiddenLayers, int tHiddenLayerSize, int tOutputLayerSize);
+	std::vector<std::shared_ptr<const SnakePerceptron>> perceptrons;
 	int numHiddenLayers;
 	int hiddenLayerSize;
 	int outputLayerSize;
 	int numInputs;
+	// Steps of the last game the brain played. A child starts with the mean of its parents', as a guess of how
+	//	long its games are. 0 when unknown
+	int expectedSteps = 0;
 
 	void init(int tNumInputs, int tNumHiddenLayers, int tHiddenLayerSize, int tOutputLayerSize);
 	std::vector<float> think(const std::vector<float>& inputs);
+	// Same as above without allocating. The outputs are stored in buffers. Uses the sparse or blocked form when compiled
+	std::span<const float> think(std::span<const float> inputs, ThinkBuffers& buffers);
+	// Cheap, since the perceptrons are shared. Changing one of the brains doesn't affect the other
 	SnakeBrain clone();
+	// Perceptron idx for writing. Copies it first if another brain shares it. Call weightsChanged() once before
+	//	changing any perceptrons
+	SnakePerceptron* mutablePerceptron(int idx);
+	// Clears the decision cache and drops the compiled forms, which no longer match once the weights change. Once
+	//	per batch of changes, eg. a whole genome, since clearing the cache touches all of it
+	void weightsChanged();
+	// Makes think() skip zero weights and neurons that can't affect the outputs, see SparseBrain. Only worth it
+	//	once the brain is pruned. Copies of the brain share the sparse form until one of them is changed
+	void compileSparse();
+	// nullptr unless compiled
+	const SparseBrain* sparseBrain();
+	// Makes think() use BlockedBrain, which is faster for wide layers. Shared between copies like the sparse form,
+	//	which is used instead if both are compiled
+	void compileBlocked();
+	// nullptr unless compiled
+	const BlockedBrain* blockedBrain();
+	// Remembers up to capacity decisions, see DecisionCache. 0 turns it off. Copies of the brain share the cache
+	//	until one of them is changed. Don't call while the brain is playing
+	void setDecisionCache(int capacity);
+	// nullptr when turned off
+	DecisionCache* decisionCache();
+	// All weights and biases as one flat vector: perceptron by perceptron, weights followed by bias
+	std::vector<float> toGenome();
+	// Same as above, into genome which must hold genomeSize() floats
+	void toGenome(std::span<float> genome);
+	void setGenome(std::span<const float> genome);
+	int genomeSize();
+	// Saves the brain in the format described in genome_file.h. Returns false on failure
+	bool save(const std::string& path);
 private:
 	std::vector<int> layerSizes;
+	std::shared_ptr<DecisionCache> cache;
+	std::shared_ptr<const SparseBrain> sparse;
+	std::shared_ptr<const BlockedBrain> blocked;
+	void initLayers(int tNumInputs, int tNumHiddenLayers, int tHiddenLayerSize, int tOutputLayerSize);
 	std::vector<float> processLayer(std::vector<float> inActivations, std::vector<float> weights, float (*activationFunction)(float));
 	int layerIdToPerceptronId(int layerIdx, int localIdx);
 };
 
 class Snake {
 public:
-	Snake(SnakeBrain* tSnakeBrain, Vec2i tPos);
-	SnakeMove think(std::vector<float> input);
+	// Everything that belongs to the snake is allocated from resource
+	Snake(SnakeBrain* tSnakeBrain, Vec2i tPos, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+	SnakeMove think(std::span<const float> input);
+	// Makes think() keep the activations of the hidden layers, see hiddenActivations(). Bypasses the decision cache
+	void setKeepHidden(bool keepHidden);
+	// Hidden activations from the last think()
+	std::span<const float> hiddenActivations();
 	void updateDirection(SnakeMove move);
 	Vec2i nextPosition();
 	void move();
 	SnakeBrain* snakeBrain;
 	Vec2i position;
 	SnakeDirection direction;
-	std::vector<Vec2i> body;
+	std::pmr::vector<Vec2i> body;
 	bool ateLastMove;
 	bool isAlive;
+private:
+	ThinkBuffers thinkBuffers;
 };
\ No newline at end of file
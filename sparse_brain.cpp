@@ -0,0 +1,126 @@
+#include "sparse_brain.h"
+
+SparseBrain::SparseBrain(SnakeBrain& brain) {
+	std::vector<int> layerSizes = { brain.numInputs };
+	for (int i = 0; i < brain.numHiddenLayers; i++) {
+		layerSizes.push_back(brain.hiddenLayerSize);
+	}
+	layerSizes.push_back(brain.outputLayerSize);
+
+	std::vector<int> perceptronOffsets = { 0 };
+	for (int idxLayer = 1; idxLayer < layerSizes.size(); idxLayer++) {
+		perceptronOffsets.push_back(perceptronOffsets.back() + layerSizes[idxLayer]);
+	}
+
+	// Walk backwards to find the neurons that matter: all outputs, and every neuron with a non-zero weight
+	//	into a neuron that matters. Inputs are always kept so they can be passed as is
+	std::vector<std::vector<bool>> kept(layerSizes.size());
+	kept.back().assign(layerSizes.back(), true);
+	kept.front().assign(layerSizes.front(), true);
+	for (int idxLayer = static_cast<int>(layerSizes.size()) - 2; idxLayer > 0; idxLayer--) {
+		kept[idxLayer].assign(layerSizes[idxLayer], false);
+		for (int k = 0; k < layerSizes[idxLayer + 1]; k++) {
+			if (!kept[idxLayer + 1][k]) {
+				continue;
+			}
+			auto& w = brain.perceptrons[perceptronOffsets[idxLayer] + k]->w;
+			for (int j = 0; j < layerSizes[idxLayer]; j++) {
+				if (w[j] != 0.0f) {
+					kept[idxLayer][j] = true;
+				}
+			}
+		}
+	}
+
+	numHidden = 0;
+	std::vector<int> compactIndex(layerSizes.front());
+	for (int j = 0; j < layerSizes.front(); j++) {
+		compactIndex[j] = j;
+	}
+
+	for (int idxLayer = 1; idxLayer < layerSizes.size(); idxLayer++) {
+		Layer layer;
+		layer.originalSize = layerSizes[idxLayer];
+		layer.rowStart.push_back(0);
+		std::vector<int> nextCompactIndex(layerSizes[idxLayer], -1);
+
+		for (int k = 0; k < layerSizes[idxLayer]; k++) {
+			if (!kept[idxLayer][k]) {
+				continue;
+			}
+			auto& perceptron = *brain.perceptrons[perceptronOffsets[idxLayer - 1] + k];
+			// Same order as in SnakeBrain::think, so the sums are exactly the same
+			for (int j = 0; j < layerSizes[idxLayer - 1]; j++) {
+				if (perceptron.w[j] != 0.0f) {
+					layer.columns.push_back(static_cast<uint16_t>(compactIndex[j]));
+					layer.values.push_back(perceptron.w[j]);
+				}
+			}
+			layer.rowStart.push_back(static_cast<int>(layer.values.size()));
+			layer.biases.push_back(perceptron.b);
+			nextCompactIndex[k] = static_cast<int>(layer.originalIndex.size());
+			layer.originalIndex.push_back(k);
+		}
+
+		if (idxLayer < layerSizes.size() - 1) {
+			numHidden += layer.originalSize;
+		}
+		compactIndex = nextCompactIndex;
+		layers.push_back(std::move(layer));
+	}
+}
+
+std::span<const float> SparseBrain::think(std::span<const float> inputs, ThinkBuffers& buffers) const {
+	auto& activations = buffers.current;
+	auto& newActivations = buffers.next;
+
+	activations.assign(inputs.begin(), inputs.end());
+	if (buffers.keepHidden) {
+		buffers.hidden.assign(numHidden, 0.0f);
+	}
+
+	int hiddenOffset = 0;
+	for (int idxLayer = 0; idxLayer < layers.size(); idxLayer++) {
+		auto& layer = layers[idxLayer];
+		const int numRows = static_cast<int>(layer.biases.size());
+		newActivations.resize(numRows);
+
+		for (int row = 0; row < numRows; row++) {
+			float activation = 0;
+			for (int idx = layer.rowStart[row]; idx < layer.rowStart[row + 1]; idx++) {
+				activation += activations[layer.columns[idx]] * layer.values[idx];
+			}
+			newActivations[row] = relu(activation + layer.biases[row]);
+		}
+
+		if (buffers.keepHidden && idxLayer < layers.size() - 1) {
+			for (int row = 0; row < numRows; row++) {
+				buffers.hidden[hiddenOffset + layer.originalIndex[row]] = newActivations[row];
+			}
+			hiddenOffset += layer.originalSize;
+		}
+		activations.swap(newActivations);
+	}
+
+	return activations;
+}
+
+int SparseBrain::numWeights() const {
+	int num = 0;
+
+	for (auto& layer : layers) {
+		num += static_cast<int>(layer.values.size());
+	}
+
+	return num;
+}
+
+int SparseBrain::numHiddenNeurons() const {
+	int num = 0;
+
+	for (int idxLayer = 0; idxLayer < static_cast<int>(layers.size()) - 1; idxLayer++) {
+		num += static_cast<int>(layers[idxLayer].biases.size());
+	}
+
+	return num;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <span>
+
+#include "snake.h"
+
+// Compiled form of a SnakeBrain that only stores the non-zero weights, row by row (CSR), and leaves out hidden
+//	neurons that can't affect the outputs because all their outgoing weights are zero. Gives the same outputs as
+//	the brain it was compiled from, so it pays off once the brain has been pruned, see pruning.h
+class SparseBrain {
+public:
+	SparseBrain(SnakeBrain& brain);
+
+	// Same as SnakeBrain::think. Left out neurons have a hidden activation of 0
+	std::span<const float> think(std::span<const float> inputs, ThinkBuffers& buffers) const;
+	int numWeights() const;
+	int numHiddenNeurons() const;
+private:
+	struct Layer {
+		// Weights of kept neuron i are values[rowStart[i]] to values[rowStart[i + 1] - 1]
+		std::vector<int> rowStart;
+		// Index of the input of each weight, among the kept neurons of the previous layer
+		std::vector<uint16_t> columns;
+		std::vector<float> values;
+		std::vector<float> biases;
+		// Index in the original layer of each kept neuron
+		std::vector<int> originalIndex;
+		int originalSize;
+	};
+
+	std::vector<Layer> layers;
+	int numHidden;
+};
@@ -0,0 +1,119 @@
+#include <format>
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <algorithm>
+#include <numeric>
+#include <filesystem>
+#include <SDL2/SDL_timer.h>
+
+#include "sweep.h"
+#include "worker_pool.h"
+#include "trace.h"
+
+namespace ClSnake {
+
+	namespace {
+		// path with the name of the run before the extension, eg. clsnake_trajectories_baseline.bin
+		std::string runPath(const std::string& path, const std::string& runName) {
+			std::filesystem::path runFile = path;
+			runFile.replace_filename(runFile.stem().string() + "_" + runName + runFile.extension().string());
+
+			return runFile.string();
+		}
+	}
+
+	bool loadSweep(const std::string& path, const SnakeConfiguration& base, std::vector<SweepRun>& runs) {
+		std::ifstream in(path);
+
+		if (!in) {
+			std::cout << "Failed to open sweep file " << path << std::endl;
+			return false;
+		}
+
+		std::string line;
+		bool ok = true;
+
+		while (std::getline(in, line)) {
+			auto first = line.find_first_not_of(" \t\r");
+			if (first == std::string::npos || line[first] == '#') {
+				continue;
+			}
+			auto colon = line.find(':');
+			if (colon == std::string::npos) {
+				std::cout << "Expected name: settings, got " << line << std::endl;
+				ok = false;
+				continue;
+			}
+
+			SweepRun run;
+			run.name = line.substr(first, colon - first);
+			run.name.erase(run.name.find_last_not_of(" \t") + 1);
+			run.config = base;
+			// The runs print at the same time, so only the summary is readable
+			run.config.evolution.printProgress = false;
+			// The messages above name the key, this names the run
+			if (!run.config.apply(line.substr(colon + 1)) || !run.config.validate()) {
+				std::cout << "Bad settings for sweep run " << run.name << std::endl;
+				ok = false;
+			}
+			// The runs record at the same time, so they can't share a file
+			if (run.config.record.enabled) {
+				run.config.record.outputPath = runPath(run.config.record.outputPath, run.name);
+			}
+			runs.push_back(run);
+		}
+
+		return ok;
+	}
+
+	std::vector<SweepResult> runSweep(const std::vector<SweepRun>& runs, const SnakeConfiguration& base) {
+		WorkerPool pool(base.threads.numThreads, base.threads.affinity, base.threads.arenaBytes);
+		std::vector<SweepResult> results(runs.size());
+		std::vector<std::thread> drivers;
+
+		std::cout << std::format("Running {} configurations on {} threads", runs.size(), pool.size()) << std::endl;
+
+		// The drivers only breed and wait; the games are played on the pool
+		for (int idxRun = 0; idxRun < runs.size(); idxRun++) {
+			drivers.push_back(std::thread([&runs, &results, &pool, idxRun]() {
+				auto startTime = SDL_GetTicks64();
+				std::vector<SnakeBrain> replaySnakeBrains;
+				int useSnakeBrainGeneration = 0;
+
+				results[idxRun].name = runs[idxRun].name;
+				results[idxRun].evolution = evolve(runs[idxRun].config, pool, replaySnakeBrains, useSnakeBrainGeneration);
+				results[idxRun].wallTimeS = (SDL_GetTicks64() - startTime) / 1000.0f;
+				std::cout << std::format("Finished {}", runs[idxRun].name) << std::endl;
+				}));
+		}
+
+		for (auto& t : drivers) {
+			t.join();
+		}
+
+		TRACE_DUMP(base.trace.outputPath);
+
+		return results;
+	}
+
+	void printSweepResults(const std::vector<SweepResult>& results) {
+		std::vector<int> order(results.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&results](int a, int b) {return results[a].evolution.bestFitness > results[b].evolution.bestFitness; });
+
+		size_t nameWidth = 4;
+		for (auto& result : results) {
+			nameWidth = std::max(nameWidth, result.name.size());
+		}
+
+		auto pad = [nameWidth](const std::string& name) { return name + std::string(nameWidth - name.size(), ' '); };
+
+		std::cout << std::format("{}  {:>12}  {:>10}  {:>10}  {:>12}", pad("Name"), "Best fitness", "Time (s)", "Games", "Steps/s") << std::endl;
+		for (auto idx : order) {
+			auto& result = results[idx];
+			auto stepsPerS = static_cast<long long>(result.evolution.numSteps / std::max(0.001f, result.wallTimeS));
+			std::cout << std::format("{}  {:>12}  {:>10.1f}  {:>10}  {:>12}", pad(result.name), result.evolution.bestFitness, result.wallTimeS, result.evolution.numGames, stepsPerS) << std::endl;
+		}
+	}
+}
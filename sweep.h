@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "evolution.h"
+
+namespace ClSnake {
+
+	struct SweepRun {
+		std::string name;
+		SnakeConfiguration config;
+	};
+
+	struct SweepResult {
+		std::string name;
+		EvolutionResult evolution;
+		float wallTimeS = 0;
+	};
+
+	// Reads one run per line, "name: key=value key=value ...", with the settings applied on top of base.
+	//	Empty lines and lines starting with # are skipped
+	bool loadSweep(const std::string& path, const SnakeConfiguration& base, std::vector<SweepRun>& runs);
+	// Runs all evolutions at the same time, on one pool set up from base.threads. The workers take turns between
+	//	the runs, one game at a time, so a run with big generations doesn't starve the others
+	std::vector<SweepResult> runSweep(const std::vector<SweepRun>& runs, const SnakeConfiguration& base);
+	void printSweepResults(const std::vector<SweepResult>& results);
+}
@@ -0,0 +1,83 @@
+#include <format>
+#include <iostream>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <limits>
+
+#include "think_benchmark.h"
+#include "snake.h"
+#include "blocked_brain.h"
+#include "worker_pool.h"
+
+namespace ClSnake {
+
+	namespace {
+		const int minWidth = 16;
+		const int maxWidth = 1024;
+		const int batchSize = 64;
+		const int numInputVectors = 256;
+		// Each timing runs for at least this long, and the best of numTimings is kept
+		const double minTimingS = 0.05;
+		const int numTimings = 3;
+
+		// Nanoseconds per call of fn
+		double timeNs(const std::function<void()>& fn) {
+			double bestNs = std::numeric_limits<double>::max();
+
+			for (int idxTiming = 0; idxTiming < numTimings; idxTiming++) {
+				long long numCalls = 0;
+				auto start = std::chrono::steady_clock::now();
+				std::chrono::duration<double> elapsed(0);
+				while (elapsed.count() < minTimingS) {
+					fn();
+					numCalls++;
+					elapsed = std::chrono::steady_clock::now() - start;
+				}
+				bestNs = std::min(bestNs, elapsed.count() * 1e9 / numCalls);
+			}
+
+			return bestNs;
+		}
+	}
+
+	void runThinkBenchmark(const SnakeConfiguration& config) {
+		WorkerPool pool(config.threads.numThreads, config.threads.affinity, config.threads.arenaBytes);
+		const int numInputs = config.numInputs();
+
+		std::vector<float> inputs = getRandomFloats(0.0f, 1.0f, numInputs * numInputVectors);
+		// Summed so the compiler can't skip the thinking
+		volatile float sink = 0;
+
+		std::cout << std::format("{} hidden layers, {} threads. Time per think in microseconds", config.brain.numHiddenLayers, pool.size()) << std::endl;
+		std::cout << std::format("{:>6}  {:>10}  {:>10}  {:>10}  {:>10}  {:>10}  {:>8}", "Width", "Parameters", "Dense", "Blocked", "Pool", "Batch", "Speedup") << std::endl;
+
+		for (int width = minWidth; width <= maxWidth; width *= 2) {
+			SnakeBrain dense(numInputs, config.brain.numHiddenLayers, width, config.brain.outputLayerSize);
+			SnakeBrain blocked = dense.clone();
+			blocked.compileBlocked();
+			const BlockedBrain* engine = blocked.blockedBrain();
+			ThinkBuffers buffers;
+			std::vector<float> outputs;
+			int idxInput = 0;
+
+			auto nextInput = [&inputs, &idxInput, numInputs]() {
+				idxInput = (idxInput + 1) % numInputVectors;
+				return std::span<const float>(inputs.data() + idxInput * numInputs, numInputs);
+			};
+
+			double denseNs = timeNs([&]() { sink = sink + dense.think(nextInput(), buffers)[0]; });
+			double blockedNs = timeNs([&]() { sink = sink + engine->think(nextInput(), buffers)[0]; });
+			double poolNs = timeNs([&]() { sink = sink + engine->think(nextInput(), buffers, pool)[0]; });
+			double batchNs = timeNs([&]() {
+				idxInput = (idxInput + batchSize) % (numInputVectors - batchSize);
+				engine->thinkBatch(std::span<const float>(inputs.data() + idxInput * numInputs, batchSize * numInputs), batchSize, buffers, outputs);
+				sink = sink + outputs[0];
+				}) / batchSize;
+
+			std::cout << std::format("{:>6}  {:>10}  {:>10.2f}  {:>10.2f}  {:>10.2f}  {:>10.2f}  {:>7.1f}x",
+				width, dense.genomeSize(), denseNs / 1000, blockedNs / 1000, poolNs / 1000, batchNs / 1000,
+				denseNs / std::min(blockedNs, poolNs)) << std::endl;
+		}
+	}
+}
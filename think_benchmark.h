@@ -0,0 +1,11 @@
+#pragma once
+
+#include "config.h"
+
+namespace ClSnake {
+
+	// Times one think for brains with config.brain.numHiddenLayers hidden layers of 16 to 1024 neurons: with
+	//	SnakeBrain's own loop, with BlockedBrain on one thread and on a pool set up from config.threads, and per
+	//	input with BlockedBrain::thinkBatch(). Prints one line per width
+	void runThinkBenchmark(const SnakeConfiguration& config);
+}
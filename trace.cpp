@@ -0,0 +1,127 @@
+#include "trace.h"
+
+#if CLSNAKE_TRACE
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <format>
+#include <iostream>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace ClSnake::Trace {
+
+	struct Event {
+		const char* name;
+		uint64_t start;
+		uint64_t end;
+	};
+
+	// Only the owning thread writes. numEvents is published with release, so dump() can read and reset it while
+	//	threads are idle
+	struct ThreadBuffer {
+		static const int capacity = 1 << 18;
+		std::unique_ptr<Event[]> events = std::make_unique<Event[]>(capacity);
+		std::atomic<int> numEvents = 0;
+		std::atomic<long long> numDropped = 0;
+		int threadIdx = 0;
+	};
+
+	thread_local bool inSampledStep = false;
+
+	namespace {
+		std::mutex buffersMutex;
+		// Owned here rather than by the threads, so the events survive threads that have exited
+		std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+		uint64_t steadyNowNs() {
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		// Pairs of time stamp counter and steady clock, to convert ticks to microseconds when dumping
+		const uint64_t startTicks = now();
+		const uint64_t startNs = steadyNowNs();
+
+		ThreadBuffer* registerThread() {
+			std::lock_guard<std::mutex> lock(buffersMutex);
+			buffers.push_back(std::make_unique<ThreadBuffer>());
+			buffers.back()->threadIdx = static_cast<int>(buffers.size());
+			return buffers.back().get();
+		}
+
+		thread_local ThreadBuffer* threadBuffer = nullptr;
+	}
+
+	uint64_t now() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return steadyNowNs();
+#endif
+	}
+
+	void record(const char* name, uint64_t start, uint64_t end) {
+		if (threadBuffer == nullptr) {
+			threadBuffer = registerThread();
+		}
+
+		int idx = threadBuffer->numEvents.load(std::memory_order_relaxed);
+		if (idx >= ThreadBuffer::capacity) {
+			threadBuffer->numDropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		threadBuffer->events[idx] = Event{ name, start, end };
+		threadBuffer->numEvents.store(idx + 1, std::memory_order_release);
+	}
+
+	bool dump(const std::string& path) {
+		double ticksPerUs = static_cast<double>(now() - startTicks) / std::max<uint64_t>(1, (steadyNowNs() - startNs) / 1000);
+
+		std::ofstream out(path);
+		if (!out) {
+			std::cout << "Failed to open trace file " << path << std::endl;
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(buffersMutex);
+
+		long long numEvents = 0;
+		long long numDropped = 0;
+		bool first = true;
+
+		out << "{\"traceEvents\":[\n";
+		for (auto& buffer : buffers) {
+			out << std::format("{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"Thread {}\"}}}}", first ? "" : ",\n", buffer->threadIdx, buffer->threadIdx);
+			first = false;
+
+			int count = buffer->numEvents.load(std::memory_order_acquire);
+			for (int i = 0; i < count; i++) {
+				auto& e = buffer->events[i];
+				double ts = (e.start - startTicks) / ticksPerUs;
+				double dur = (e.end - e.start) / ticksPerUs;
+				out << std::format(",\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}", e.name, buffer->threadIdx, ts, dur);
+			}
+			numEvents += count;
+			numDropped += buffer->numDropped;
+			// Start over, so the next dump doesn't write these events again
+			buffer->numEvents.store(0, std::memory_order_release);
+			buffer->numDropped = 0;
+		}
+		out << "\n]}\n";
+
+		std::cout << std::format("Wrote {} trace events to {} ({} dropped since a buffer was full)", numEvents, path, numDropped) << std::endl;
+
+		return true;
+	}
+}
+
+#endif
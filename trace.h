@@ -0,0 +1,77 @@
+#pragma once
+
+// Scoped tracing of where the time goes during evolution. Build with CLSNAKE_TRACE=1 (eg. as a preprocessor
+//	definition) to record events; otherwise all TRACE_ macros compile to nothing.
+//
+// Events are written to a fixed size buffer per thread without any locking, using the time stamp counter.
+//	TRACE_DUMP writes them as Chrome trace JSON that can be opened in chrome://tracing or ui.perfetto.dev.
+//	The dumped events are cleared, so a later dump only has what was recorded since. Only dump while no other
+//	thread is recording.
+//
+// Per step events are too many to keep them all, so TRACE_STEP_SCOPE only records every n:th step on each thread.
+//	TRACE_SAMPLED_SCOPE records only when inside such a recorded step, so the nested spans line up.
+//
+// Names must be string literals.
+#ifndef CLSNAKE_TRACE
+#define CLSNAKE_TRACE 0
+#endif
+
+#if CLSNAKE_TRACE
+
+#include <cstdint>
+#include <string>
+
+namespace ClSnake::Trace {
+
+	uint64_t now();
+	void record(const char* name, uint64_t start, uint64_t end);
+	bool dump(const std::string& path);
+
+	// True while the current thread is inside a recorded TRACE_STEP_SCOPE
+	extern thread_local bool inSampledStep;
+
+	class Scope {
+	public:
+		// No event is recorded if tName is nullptr
+		Scope(const char* tName) : name(tName), start(tName != nullptr ? now() : 0) {}
+		~Scope() {
+			if (name != nullptr) {
+				record(name, start, now());
+			}
+		}
+	private:
+		const char* name;
+		uint64_t start;
+	};
+
+	class StepScope {
+	public:
+		StepScope(const char* tName, bool sampled) : scope(sampled ? tName : nullptr), wasInSampledStep(inSampledStep) {
+			inSampledStep = sampled;
+		}
+		~StepScope() {
+			inSampledStep = wasInSampledStep;
+		}
+	private:
+		Scope scope;
+		bool wasInSampledStep;
+	};
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) ClSnake::Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_STEP_SCOPE(name, sampleEvery) \
+	static thread_local unsigned int TRACE_CONCAT(traceStepCounter, __LINE__) = 0; \
+	ClSnake::Trace::StepScope TRACE_CONCAT(traceScope, __LINE__)(name, TRACE_CONCAT(traceStepCounter, __LINE__)++ % (sampleEvery) == 0)
+#define TRACE_SAMPLED_SCOPE(name) ClSnake::Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(ClSnake::Trace::inSampledStep ? name : nullptr)
+#define TRACE_DUMP(path) ClSnake::Trace::dump(path)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_STEP_SCOPE(name, sampleEvery)
+#define TRACE_SAMPLED_SCOPE(name)
+#define TRACE_DUMP(path)
+
+#endif
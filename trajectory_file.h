@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+// File format of recorded games, written by TrajectoryRecorder. It is made to be memory mapped and read in place:
+//	a TrajectoryFileHeader followed by batches of rows, one row per step. Each batch is a TrajectoryBatchHeader
+//	followed by its columns. Headers and columns all start at a multiple of trajectoryAlignment bytes from the
+//	start of the file. The columns, in this order:
+//
+//	game	uint32 per row: number of the game during evolution
+//	step	uint32 per row: step within the game, from 0
+//	inputs	numInputs floats per row: the measurements given to the brain
+//	hidden	numHidden floats per row: activations of all hidden layers, first layer first
+//	move	uint8 per row: the move made, as SnakeMove (0 = left, 1 = right, 2 = forward)
+//	reward	int32 per row: change in fitness from the step
+//	done	uint8 per row: 1 on the last step of a game
+//
+// The steps of a game are in order, but a game can be spread over several batches.
+const int trajectoryAlignment = 64;
+const int trajectoryNumColumns = 7;
+
+struct TrajectoryFileHeader {
+	char magic[4] = { 'C', 'L', 'S', 'T' };
+	uint32_t version = 1;
+	int32_t numInputs = 0;
+	int32_t numHidden = 0;
+};
+
+struct TrajectoryBatchHeader {
+	char magic[4] = { 'B', 'A', 'T', 'C' };
+	uint32_t numRows = 0;
+	// From the start of this header to the next one
+	uint64_t batchBytes = 0;
+	// From the start of this header, in the order above
+	uint64_t columnOffsets[trajectoryNumColumns] = {};
+};
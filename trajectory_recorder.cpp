@@ -0,0 +1,240 @@
+#include <algorithm>
+
+#include "trajectory_recorder.h"
+#include "trajectory_file.h"
+#include "worker_pool.h"
+
+namespace ClSnake {
+
+	namespace {
+		uint64_t aligned(uint64_t numBytes) {
+			return (numBytes + trajectoryAlignment - 1) / trajectoryAlignment * trajectoryAlignment;
+		}
+
+		template<typename T>
+		void writePadded(std::ofstream& out, const std::vector<T>& column) {
+			static const char zeros[trajectoryAlignment] = {};
+			uint64_t numBytes = column.size() * sizeof(T);
+
+			out.write(reinterpret_cast<const char*>(column.data()), numBytes);
+			out.write(zeros, aligned(numBytes) - numBytes);
+		}
+	}
+
+	void TrajectoryRecorder::Batch::clear() {
+		game.clear();
+		step.clear();
+		inputs.clear();
+		hidden.clear();
+		move.clear();
+		reward.clear();
+		done.clear();
+	}
+
+	int TrajectoryRecorder::Batch::numRows() {
+		return static_cast<int>(game.size());
+	}
+
+	TrajectoryRecorder::TrajectoryRecorder(const std::string& path, int tNumInputs, int tNumHidden, int tRecordEvery, int tBatchRows, int numWorkers) :
+		numInputs(tNumInputs), numHidden(tNumHidden), recordEvery(std::max(1, tRecordEvery)), batchRows(std::max(1, tBatchRows)), out(path, std::ios::binary) {
+
+		if (!out) {
+			return;
+		}
+
+		TrajectoryFileHeader header;
+		header.numInputs = numInputs;
+		header.numHidden = numHidden;
+		static const char zeros[trajectoryAlignment] = {};
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(zeros, aligned(sizeof(header)) - sizeof(header));
+
+		for (int i = 0; i < numWorkers + 1; i++) {
+			workerBatches.push_back(std::make_unique<Batch>());
+		}
+
+		writer = std::thread([this]() { writerLoop(); });
+	}
+
+	TrajectoryRecorder::~TrajectoryRecorder() {
+		if (!writer.joinable()) {
+			return;
+		}
+
+		for (auto& batch : workerBatches) {
+			if (batch->numRows() > 0) {
+				batch = submit(std::move(batch));
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopping = true;
+		}
+		queueChanged.notify_all();
+		writer.join();
+	}
+
+	bool TrajectoryRecorder::isOpen() {
+		return writer.joinable();
+	}
+
+	bool TrajectoryRecorder::selectGame(uint32_t& gameNumber) {
+		gameNumber = nextGame++;
+
+		return gameNumber % recordEvery == 0;
+	}
+
+	long long TrajectoryRecorder::numRecordedSteps() {
+		return numSteps;
+	}
+
+	std::unique_ptr<TrajectoryRecorder::Batch> TrajectoryRecorder::startGame() {
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			if (!freeBatches.empty()) {
+				auto batch = std::move(freeBatches.back());
+				freeBatches.pop_back();
+				return batch;
+			}
+		}
+
+		return std::make_unique<Batch>();
+	}
+
+	void TrajectoryRecorder::addStep(std::unique_ptr<Batch>& gameSteps, uint32_t gameNumber, uint32_t step, std::span<const float> inputs, std::span<const float> hidden, SnakeMove move, int32_t reward, bool done) {
+		if (!isOpen()) {
+			return;
+		}
+
+		Batch& batch = *gameSteps;
+		batch.game.push_back(gameNumber);
+		batch.step.push_back(step);
+		// Always numInputs and numHidden values per row, so the columns stay rectangular
+		for (int i = 0; i < numInputs; i++) {
+			batch.inputs.push_back(i < inputs.size() ? inputs[i] : 0.0f);
+		}
+		for (int i = 0; i < numHidden; i++) {
+			batch.hidden.push_back(i < hidden.size() ? hidden[i] : 0.0f);
+		}
+		batch.move.push_back(static_cast<uint8_t>(move));
+		batch.reward.push_back(reward);
+		batch.done.push_back(done ? 1 : 0);
+		numSteps++;
+
+		// The earlier steps of the game are queued before anything the game adds later
+		if (batch.numRows() >= batchRows) {
+			gameSteps = submit(std::move(gameSteps));
+		}
+	}
+
+	void TrajectoryRecorder::endGame(std::unique_ptr<Batch> gameSteps) {
+		if (isOpen() && gameSteps->numRows() > 0) {
+			append(*gameSteps);
+		}
+
+		gameSteps->clear();
+		std::lock_guard<std::mutex> lock(queueMutex);
+		freeBatches.push_back(std::move(gameSteps));
+	}
+
+	void TrajectoryRecorder::append(const Batch& from) {
+		auto appendTo = [this, &from](std::unique_ptr<Batch>& batch) {
+			batch->game.insert(batch->game.end(), from.game.begin(), from.game.end());
+			batch->step.insert(batch->step.end(), from.step.begin(), from.step.end());
+			batch->inputs.insert(batch->inputs.end(), from.inputs.begin(), from.inputs.end());
+			batch->hidden.insert(batch->hidden.end(), from.hidden.begin(), from.hidden.end());
+			batch->move.insert(batch->move.end(), from.move.begin(), from.move.end());
+			batch->reward.insert(batch->reward.end(), from.reward.begin(), from.reward.end());
+			batch->done.insert(batch->done.end(), from.done.begin(), from.done.end());
+			if (batch->numRows() >= batchRows) {
+				batch = submit(std::move(batch));
+			}
+		};
+
+		int idxWorker = WorkerPool::currentWorker();
+
+		if (idxWorker < 0 || idxWorker >= static_cast<int>(workerBatches.size()) - 1) {
+			std::lock_guard<std::mutex> lock(outsideMutex);
+			appendTo(workerBatches.back());
+			return;
+		}
+
+		appendTo(workerBatches[idxWorker]);
+	}
+
+	std::unique_ptr<TrajectoryRecorder::Batch> TrajectoryRecorder::submit(std::unique_ptr<Batch> batch) {
+		std::unique_lock<std::mutex> lock(queueMutex);
+		// Bounds the memory if the disk can't keep up
+		const size_t maxQueued = workerBatches.size() * 2;
+		queueChanged.wait(lock, [this, maxQueued]() { return queue.size() < maxQueued; });
+		queue.push_back(std::move(batch));
+		queueChanged.notify_all();
+
+		if (freeBatches.empty()) {
+			return std::make_unique<Batch>();
+		}
+
+		auto freeBatch = std::move(freeBatches.back());
+		freeBatches.pop_back();
+
+		return freeBatch;
+	}
+
+	void TrajectoryRecorder::writerLoop() {
+		while (true) {
+			std::unique_ptr<Batch> batch;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				queueChanged.wait(lock, [this]() { return stopping || !queue.empty(); });
+				if (queue.empty()) {
+					return;
+				}
+				batch = std::move(queue.front());
+				queue.pop_front();
+			}
+
+			writeBatch(*batch);
+			batch->clear();
+
+			{
+				std::lock_guard<std::mutex> lock(queueMutex);
+				freeBatches.push_back(std::move(batch));
+			}
+			queueChanged.notify_all();
+		}
+	}
+
+	void TrajectoryRecorder::writeBatch(Batch& batch) {
+		TrajectoryBatchHeader header;
+		header.numRows = batch.numRows();
+
+		const uint64_t columnBytes[trajectoryNumColumns] = {
+			batch.game.size() * sizeof(uint32_t),
+			batch.step.size() * sizeof(uint32_t),
+			batch.inputs.size() * sizeof(float),
+			batch.hidden.size() * sizeof(float),
+			batch.move.size() * sizeof(uint8_t),
+			batch.reward.size() * sizeof(int32_t),
+			batch.done.size() * sizeof(uint8_t)
+		};
+
+		uint64_t offset = aligned(sizeof(header));
+		for (int i = 0; i < trajectoryNumColumns; i++) {
+			header.columnOffsets[i] = offset;
+			offset += aligned(columnBytes[i]);
+		}
+		header.batchBytes = offset;
+
+		static const char zeros[trajectoryAlignment] = {};
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(zeros, aligned(sizeof(header)) - sizeof(header));
+		writePadded(out, batch.game);
+		writePadded(out, batch.step);
+		writePadded(out, batch.inputs);
+		writePadded(out, batch.hidden);
+		writePadded(out, batch.move);
+		writePadded(out, batch.reward);
+		writePadded(out, batch.done);
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <span>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <fstream>
+
+#include "snake.h"
+
+namespace ClSnake {
+
+	// Streams the steps of selected games to a file in the format described in trajectory_file.h. Each recorded game
+	//	collects its steps in its own batch, so they stay in order even if the game moves between workers. A finished
+	//	game hands its steps to the batch of the worker it ended on; full batches are written by a background thread,
+	//	so the games don't wait on disk
+	class TrajectoryRecorder {
+	public:
+		// Rows of the file, one column per vector
+		struct Batch {
+			std::vector<uint32_t> game;
+			std::vector<uint32_t> step;
+			std::vector<float> inputs;
+			std::vector<float> hidden;
+			std::vector<uint8_t> move;
+			std::vector<int32_t> reward;
+			std::vector<uint8_t> done;
+
+			void clear();
+			int numRows();
+		};
+
+		// Records every recordEvery:th game. numWorkers is the size of the pool the games are played on
+		TrajectoryRecorder(const std::string& path, int tNumInputs, int tNumHidden, int tRecordEvery, int tBatchRows, int numWorkers);
+		// Writes what is left and closes the file. Every game must have ended first
+		~TrajectoryRecorder();
+
+		bool isOpen();
+		// Call once per game that could be recorded. Returns true, and the number of the game, if it should be
+		bool selectGame(uint32_t& gameNumber);
+		// Where a recorded game collects its steps until endGame()
+		std::unique_ptr<Batch> startGame();
+		// Adds a step to the steps of a game. Once they fill a batch, it's written as is
+		void addStep(std::unique_ptr<Batch>& gameSteps, uint32_t gameNumber, uint32_t step, std::span<const float> inputs, std::span<const float> hidden, SnakeMove move, int32_t reward, bool done);
+		// Moves the steps of a game that is over, or won't be played further, to the batch of the calling worker
+		void endGame(std::unique_ptr<Batch> gameSteps);
+		long long numRecordedSteps();
+	private:
+		int numInputs;
+		int numHidden;
+		int recordEvery;
+		int batchRows;
+		std::ofstream out;
+		std::atomic<uint32_t> nextGame = 0;
+		std::atomic<long long> numSteps = 0;
+		// One per worker, plus one shared by threads outside the pool
+		std::vector<std::unique_ptr<Batch>> workerBatches;
+		std::mutex outsideMutex;
+
+		// Full batches waiting for the writer, and empty ones to reuse
+		std::deque<std::unique_ptr<Batch>> queue;
+		std::vector<std::unique_ptr<Batch>> freeBatches;
+		std::mutex queueMutex;
+		std::condition_variable queueChanged;
+		bool stopping = false;
+		std::thread writer;
+
+		// Appends the rows of from to the batch of the calling worker
+		void append(const Batch& from);
+		// Hands a full batch to the writer and returns an empty one. Waits if the writer is too far behind
+		std::unique_ptr<Batch> submit(std::unique_ptr<Batch> batch);
+		void writerLoop();
+		void writeBatch(Batch& batch);
+	};
+}
@@ -1,8 +1,17 @@
 #include <random>
+#include <mutex>
 #include "utils.h"
 
 std::random_device rd;
-std::mt19937 gen(rd());
+std::mutex rdMutex;
+
+unsigned int nextSeed() {
+	std::lock_guard<std::mutex> lock(rdMutex);
+	return rd();
+}
+
+// One generator per thread, since games are played on several threads at once
+thread_local std::mt19937 gen(nextSeed());
 
 std::vector<int> getRandomInts(int tMin, int tMax, int tNum) {
 
@@ -38,3 +47,20 @@ std::vector<float> getRandomFloats(float tMin, float tMax, int tNum) {
 float getRandomFloat(float tMin, float tMax) {
 	return getRandomFloats(tMin, tMax, 1)[0];
 }
+
+std::vector<float> getRandomNormals(float tMean, float tStdDev, int tNum) {
+	std::normal_distribution<float> dist(tMean, tStdDev);
+
+	std::vector<float> vals;
+	vals.reserve(tNum);
+
+	for (int i = 0; i < tNum; i++) {
+		vals.push_back(dist(gen));
+	}
+
+	return vals;
+}
+
+void setRandomSeed(unsigned int seed) {
+	gen.seed(seed);
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <cmath>
 
 const float PI = std::acos(0.0f) * 2.0f;
@@ -52,4 +53,7 @@ struct Vec2i {
 std::vector<int> getRandomInts(int tMin, int tMax, int tNum);
 int getRandomInt(int tMin, int tMax);
 std::vector<float> getRandomFloats(float tMin, float tMax, int tNum);
-float getRandomFloat(float tMin, float tMax);
\ No newline at end of file
+float getRandomFloat(float tMin, float tMax);
+std::vector<float> getRandomNormals(float tMean, float tStdDev, int tNum);
+// Restarts the random numbers of the calling thread from seed, eg. to play the same game twice
+void setRandomSeed(unsigned int seed);
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include <algorithm>
+
+#include <iostream>
+
+#include "worker_pool.h"
+#include "affinity.h"
+#include "trace.h"
+
+namespace ClSnake {
+
+	thread_local Arena* workerArena = nullptr;
+	thread_local int workerIdx = -1;
+
+	WorkerPool::WorkerPool(int numThreads, ThreadAffinity affinity, int arenaBytes) {
+		if (numThreads <= 0) {
+			// hardware_concurrency will return 0 when not able to detect
+			numThreads = std::max(1u, std::thread::hardware_concurrency());
+		}
+
+		for (int i = 0; i < numThreads; i++) {
+			threads.push_back(std::thread([this, i, affinity, arenaBytes]() { workerLoop(i, affinity, arenaBytes); }));
+		}
+	}
+
+	WorkerPool::~WorkerPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		workAvailable.notify_all();
+
+		for (auto& t : threads) {
+			t.join();
+		}
+	}
+
+	int WorkerPool::size() {
+		return static_cast<int>(threads.size());
+	}
+
+	Arena* WorkerPool::currentArena() {
+		return workerArena;
+	}
+
+	int WorkerPool::currentWorker() {
+		return workerIdx;
+	}
+
+	void WorkerPool::parallelFor(int count, const std::function<void(int)>& fn) {
+		if (count <= 0) {
+			return;
+		}
+
+		Job newJob;
+		newJob.fn = &fn;
+		newJob.count = count;
+
+		TRACE_SCOPE("WorkerPool::parallelFor");
+		std::unique_lock<std::mutex> lock(mutex);
+		jobs.push_back(&newJob);
+		numJobs = static_cast<int>(jobs.size());
+		workAvailable.notify_all();
+		// All indices are handed out once nextIdx passes count, but they might still be running
+		workDone.wait(lock, [&newJob]() { return newJob.nextIdx >= newJob.count && newJob.numActiveWorkers == 0; });
+		jobs.erase(std::find(jobs.begin(), jobs.end(), &newJob));
+		numJobs = static_cast<int>(jobs.size());
+	}
+
+	WorkerPool::Job* WorkerPool::pickJob() {
+		for (int i = 0; i < jobs.size(); i++) {
+			Job* candidate = jobs[(nextJob + i) % jobs.size()];
+			if (candidate->nextIdx < candidate->count) {
+				nextJob = (nextJob + i + 1) % jobs.size();
+				return candidate;
+			}
+		}
+
+		return nullptr;
+	}
+
+	void WorkerPool::workerLoop(int idxWorker, ThreadAffinity affinity, int arenaBytes) {
+		if (!pinCurrentThread(affinity, idxWorker)) {
+			std::cout << "Failed to set affinity of worker " << idxWorker << std::endl;
+		}
+
+		// Created after pinning, so the memory is local to where the worker runs
+		Arena arena(arenaBytes);
+		workerArena = &arena;
+		workerIdx = idxWorker;
+
+		while (true) {
+			Job* curJob = nullptr;
+			{
+				TRACE_SCOPE("WorkerPool::idle");
+				std::unique_lock<std::mutex> lock(mutex);
+				workAvailable.wait(lock, [this, &curJob]() { return stopping || (curJob = pickJob()) != nullptr; });
+				if (stopping) {
+					return;
+				}
+				curJob->numActiveWorkers++;
+			}
+
+			// Grab one index at a time; game lengths vary a lot, so static partitioning would leave threads idle.
+			//	With several jobs running we go back to pickJob() after each index, so they share the workers evenly
+			for (int idx = curJob->nextIdx++; idx < curJob->count; idx = curJob->nextIdx++) {
+				(*curJob->fn)(idx);
+				if (numJobs > 1) {
+					break;
+				}
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				curJob->numActiveWorkers--;
+				if (curJob->numActiveWorkers == 0) {
+					workDone.notify_all();
+				}
+			}
+		}
+	}
+}
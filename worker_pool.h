@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory_resource>
+
+#include "config.h"
+#include "arena.h"
+
+namespace ClSnake {
+
+	// Fixed set of threads that are kept alive between generations, so we don't pay for thread creation per game
+	class WorkerPool {
+	public:
+		// numThreads = 0 means one thread per hardware thread. Each worker gets its own arena of arenaBytes
+		WorkerPool(int numThreads = 0, ThreadAffinity affinity = ThreadAffinity::None, int arenaBytes = 1 << 16);
+		~WorkerPool();
+
+		int size();
+		// Runs fn(idx) for every idx on range 0 - count-1, spread over all workers. Returns when all calls are done.
+		//	Can be called from several threads at once, eg. one per sweep run; the workers then take turns between the jobs
+		void parallelFor(int count, const std::function<void(int)>& fn);
+		// Arena of the calling worker thread, or nullptr when not called from a worker
+		static Arena* currentArena();
+		// Index of the calling worker thread on range 0 - size()-1, or -1 when not called from a worker
+		static int currentWorker();
+	private:
+		// Lives on the stack of parallelFor until every worker that joined it has left
+		struct Job {
+			const std::function<void(int)>* fn;
+			int count;
+			std::atomic<int> nextIdx = 0;
+			int numActiveWorkers = 0;
+		};
+
+		std::vector<std::thread> threads;
+		std::mutex mutex;
+		std::condition_variable workAvailable;
+		std::condition_variable workDone;
+		// Running jobs, in the order they were started
+		std::vector<Job*> jobs;
+		std::atomic<int> numJobs = 0;
+		// Round-robin position in jobs, so no job is starved by another
+		int nextJob = 0;
+		bool stopping = false;
+
+		void workerLoop(int idxWorker, ThreadAffinity affinity, int arenaBytes);
+		// Next job with indices left, or nullptr. Must hold mutex
+		Job* pickJob();
+	};
+}